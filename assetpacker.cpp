@@ -0,0 +1,87 @@
+// AssetPacker: writes the files the application loads into one asset pack (see assetpack.h), with
+// a hashed table of contents and LZ4 compressed entries, which the VirtualFileSystem reads
+// instead of the loose files.
+//
+// Usage (from bin/): AssetPacker [-o output] [-store] [folders or files...]
+//   -o       pack to write, assets.pack by default (the one the application mounts)
+//   -store   no compression: every entry is used straight from the mapping
+// Without paths it packs models/, textures/ and shaders/. Run it after the application has baked
+// the mesh caches and the TextureBaker the .ctex containers, so they go in the pack too.
+
+#include <assetpack.h>
+#include <programbinarycache.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace fs = std::filesystem;
+
+static bool IsPackable(const fs::path &path)
+{
+	string extension = path.extension().string();
+	transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+	// leftovers of interrupted writes, and program binaries, which only the driver that wrote
+	// them can load
+	return extension != ".tmp" && extension != PROGRAM_BINARY_EXTENSION;
+}
+
+int main(int argc, char **argv)
+{
+	string output = "assets.pack";
+	bool compress = true;
+	vector<fs::path> inputs;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "-o" && i + 1 < argc) output = argv[++i];
+		else if (arg == "-store") compress = false;
+		else inputs.push_back(fs::path(arg));
+	}
+	if (inputs.empty()) {
+		inputs.push_back("models");
+		inputs.push_back("textures");
+		inputs.push_back("shaders");
+	}
+
+	// names relative to the working directory, as the application opens them
+	vector<AssetPackSource> sources;
+	for (size_t i = 0; i < inputs.size(); i++) {
+		error_code error;
+		if (fs::is_directory(inputs[i], error)) {
+			for (fs::recursive_directory_iterator it(inputs[i], error), end; it != end; it.increment(error)) {
+				if (!it->is_regular_file() || !IsPackable(it->path())) continue;
+				AssetPackSource source;
+				source.path = it->path().generic_string();
+				source.name = source.path;
+				sources.push_back(source);
+			}
+		}
+		else if (fs::is_regular_file(inputs[i], error)) {
+			AssetPackSource source;
+			source.path = inputs[i].generic_string();
+			source.name = source.path;
+			sources.push_back(source);
+		}
+		else
+			cout << "WARNING::ASSETPACKER:: skipping " << inputs[i].generic_string() << endl;
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	AssetPackStats stats;
+	if (!AssetPack::Write(output, sources, compress, stats)) {
+		cout << "ERROR::ASSETPACKER:: could not write " << output << endl;
+		return 1;
+	}
+	double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+	cout << output << ": " << stats.files << " files (" << stats.compressedFiles << " compressed), "
+		<< stats.bytes / 1024 << " KB -> " << stats.storedBytes / 1024 << " KB";
+	if (stats.storedBytes > 0)
+		cout << " (" << (float)stats.bytes / stats.storedBytes << "x)";
+	cout << ", " << ms << " ms" << endl;
+	return stats.files == sources.size() ? 0 : 1;
+}
@@ -5,8 +5,15 @@ layout (location = 1) in vec4  inColor;
 out vec4 vxColor;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// per-frame constants, binding point 0 (see uniformblocks.h)
+layout (std140) uniform FrameData
+{
+    mat4  view;
+    mat4  projection;
+    vec3  cameraPosition;
+    float frameTime;
+};
 
 void main()
 {
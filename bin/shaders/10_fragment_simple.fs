@@ -7,8 +7,15 @@ in vec3 ex_N;
 uniform sampler2D texture_diffuse1;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// per-frame constants, binding point 0 (see uniformblocks.h)
+layout (std140) uniform FrameData
+{
+    mat4  view;
+    mat4  projection;
+    vec3  cameraPosition;
+    float frameTime;
+};
 
 void main()
 {    
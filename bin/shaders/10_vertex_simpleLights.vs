@@ -9,8 +9,15 @@ out vec2 TexCoords;
 out vec3 ex_N;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// per-frame constants, binding point 0 (see uniformblocks.h)
+layout (std140) uniform FrameData
+{
+    mat4  view;
+    mat4  projection;
+    vec3  cameraPosition;
+    float frameTime;
+};
 
 out vec3 EyeDirection_cameraspace;
 
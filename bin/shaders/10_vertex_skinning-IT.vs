@@ -4,9 +4,9 @@ layout (location = 1) in vec3  aNormal;
 layout (location = 2) in vec2  aTexCoords;
 layout (location = 3) in vec3  tangent;
 layout (location = 4) in vec3  bitangent;
-layout (location = 5) in vec4  bIDs1;     // N max bones per vertex
-layout (location = 6) in vec4  bIDs2;     // N max bones per vertex
-layout (location = 7) in vec4  bIDs3;     // N max bones per vertex
+layout (location = 5) in uvec4 bIDs1;     // N max bones per vertex
+layout (location = 6) in uvec4 bIDs2;     // N max bones per vertex
+layout (location = 7) in uvec4 bIDs3;     // N max bones per vertex
 layout (location = 8) in vec4  bWeights1;   // N max bones per vertex
 layout (location = 9) in vec4  bWeights2;   // N max bones per vertex
 layout (location = 10) in vec4 bWeights3;   // N max bones per vertex
@@ -15,8 +15,15 @@ out vec2 TexCoords;
 out vec3 ex_N;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// per-frame constants, binding point 0 (see uniformblocks.h)
+layout (std140) uniform FrameData
+{
+    mat4  view;
+    mat4  projection;
+    vec3  cameraPosition;
+    float frameTime;
+};
 
 uniform mat4 gBones[100];
 
@@ -24,20 +31,20 @@ out vec3 EyeDirection_cameraspace;
 
 void main()
 {
-    mat4 BoneTransform = gBones[int(bIDs1[0])] * bWeights1[0];
-    BoneTransform += gBones[int(bIDs1[1])] * bWeights1[1];
-    BoneTransform += gBones[int(bIDs1[2])] * bWeights1[2];  
-    BoneTransform += gBones[int(bIDs1[3])] * bWeights1[3];// only take the first 4th bones contributions
-
-    BoneTransform += gBones[int(bIDs2[0])] * bWeights2[0];
-    BoneTransform += gBones[int(bIDs2[1])] * bWeights2[1];
-    BoneTransform += gBones[int(bIDs2[2])] * bWeights2[2]; 
-    BoneTransform += gBones[int(bIDs2[3])] * bWeights2[3]; // only take the next bones contributions
-
-    BoneTransform += gBones[int(bIDs3[0])] * bWeights3[0];
-    BoneTransform += gBones[int(bIDs3[1])] * bWeights3[1];
-    BoneTransform += gBones[int(bIDs3[2])] * bWeights3[2]; 
-    BoneTransform += gBones[int(bIDs3[3])] * bWeights3[3]; // only take the next bones contributions
+    mat4 BoneTransform = gBones[bIDs1[0]] * bWeights1[0];
+    BoneTransform += gBones[bIDs1[1]] * bWeights1[1];
+    BoneTransform += gBones[bIDs1[2]] * bWeights1[2];  
+    BoneTransform += gBones[bIDs1[3]] * bWeights1[3];// only take the first 4th bones contributions
+
+    BoneTransform += gBones[bIDs2[0]] * bWeights2[0];
+    BoneTransform += gBones[bIDs2[1]] * bWeights2[1];
+    BoneTransform += gBones[bIDs2[2]] * bWeights2[2]; 
+    BoneTransform += gBones[bIDs2[3]] * bWeights2[3]; // only take the next bones contributions
+
+    BoneTransform += gBones[bIDs3[0]] * bWeights3[0];
+    BoneTransform += gBones[bIDs3[1]] * bWeights3[1];
+    BoneTransform += gBones[bIDs3[2]] * bWeights3[2]; 
+    BoneTransform += gBones[bIDs3[3]] * bWeights3[3]; // only take the next bones contributions
 
     vec4 PosL = BoneTransform * vec4(aPos, 1.0f);
     gl_Position = projection * view * model * PosL;
@@ -0,0 +1,44 @@
+#version 330 core
+layout (location = 0) in vec3  aPos;
+layout (location = 1) in vec3  aNormal;
+layout (location = 2) in vec2  aTexCoords;
+layout (location = 3) in vec3  tangent;
+layout (location = 4) in vec3  bitangent;
+layout (location = 5) in uvec4 bIDs1;     // N max bones per vertex
+layout (location = 8) in vec4  bWeights1;   // N max bones per vertex
+
+out vec2 TexCoords;
+out vec3 ex_N;
+
+uniform mat4 model;
+
+// per-frame constants, binding point 0 (see uniformblocks.h)
+layout (std140) uniform FrameData
+{
+    mat4  view;
+    mat4  projection;
+    vec3  cameraPosition;
+    float frameTime;
+};
+
+uniform mat4 gBones[100];
+
+out vec3 EyeDirection_cameraspace;
+
+void main()
+{
+    mat4 BoneTransform = gBones[bIDs1[0]] * bWeights1[0];
+    BoneTransform += gBones[bIDs1[1]] * bWeights1[1];
+    BoneTransform += gBones[bIDs1[2]] * bWeights1[2];  
+    BoneTransform += gBones[bIDs1[3]] * bWeights1[3];// only take the first 4th bones contributions
+
+    vec4 PosL = BoneTransform * vec4(aPos, 1.0f);
+    gl_Position = projection * view * model * PosL;
+
+    TexCoords = aTexCoords;    
+    //gl_Position = projection * view * model * vec4(aPos, 1.0);
+
+    vec3 vertexPosition_cameraspace = ( view * model * vec4(aPos, 1.0)).xyz;
+    EyeDirection_cameraspace = vec3(0,0,0) - vertexPosition_cameraspace;
+    ex_N = aNormal;
+}
\ No newline at end of file
@@ -7,7 +7,14 @@ in vec3 ex_N;
 in vec3 vertexPosition_cameraspace;
 in vec3 Normal_cameraspace;
 
-uniform mat4 view;
+// per-frame constants, binding point 0 (see uniformblocks.h)
+layout (std140) uniform FrameData
+{
+    mat4  view;
+    mat4  projection;
+    vec3  cameraPosition;
+    float frameTime;
+};
 
 uniform sampler2D texture_diffuse1;
 
@@ -17,16 +24,22 @@ uniform vec4 MaterialSpecularColor;
 uniform float transparency;
 
 #define MAX_LIGHTS 10
-uniform int numLights;
 
-uniform struct Light {
+struct Light {
    vec3  Position;
    vec3  Direction;
    vec4  Color;
    vec4  Power;
    int   alphaIndex;
    float distance;
-} allLights[MAX_LIGHTS];
+};
+
+// the scene lights, binding point 1 (see uniformblocks.h)
+layout (std140) uniform LightData
+{
+    int   numLights;
+    Light allLights[MAX_LIGHTS];
+};
 
 vec4 ApplyLight(Light light, vec3 N, vec3 L, vec3 E) {
     
@@ -8,8 +8,15 @@ layout (location = 4) in vec3  bitangent;
 
 // Values that stay constant for the whole mesh.
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// per-frame constants, binding point 0 (see uniformblocks.h)
+layout (std140) uniform FrameData
+{
+    mat4  view;
+    mat4  projection;
+    vec3  cameraPosition;
+    float frameTime;
+};
 
 void main(){
 
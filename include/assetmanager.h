@@ -0,0 +1,128 @@
+#ifndef ASSETMANAGER_H
+#define ASSETMANAGER_H
+
+#include <threadpool.h>
+#include <modelstructs.h>
+#include <model.h>
+#include <animatedmodel.h>
+#include <modelasset.h>
+#include <texturecache.h>
+
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Result of an asset request. The CPU side runs on the AssetManager workers; Get() waits for it
+// and finishes the GL side, so it has to be called on the thread that owns the context.
+template <class T>
+class AssetFuture
+{
+public:
+	AssetFuture() {}
+	explicit AssetFuture(shared_future<T*> future) : future(future) {}
+
+	bool IsReady() const {
+		return future.wait_for(chrono::seconds(0)) == future_status::ready;
+	}
+
+	T* Get() {
+		T *asset = future.get();
+		if (asset != nullptr && !asset->IsUploaded())
+			asset->Upload();
+		return asset;
+	}
+
+private:
+	shared_future<T*> future;
+};
+
+// Same as AssetFuture for assets shared between several owners
+template <class T>
+class SharedAssetFuture
+{
+public:
+	SharedAssetFuture() {}
+	explicit SharedAssetFuture(shared_future<shared_ptr<T> > future) : future(future) {}
+
+	bool IsReady() const {
+		return future.wait_for(chrono::seconds(0)) == future_status::ready;
+	}
+
+	shared_ptr<T> Get() {
+		shared_ptr<T> asset = future.get();
+		if (asset && !asset->IsUploaded())
+			asset->Upload();
+		return asset;
+	}
+
+private:
+	shared_future<shared_ptr<T> > future;
+};
+
+// Loads assets on a pool of worker threads. Every request is queued right away, so all of them
+// are in flight together and the total load time approaches the one of the largest asset.
+class AssetManager
+{
+public:
+	explicit AssetManager(unsigned int numThreads = 0) : pool(numThreads) {}
+
+	AssetFuture<Model> LoadModel(const string &path, ModelLoadOptions options = ModelLoadOptions(), bool gamma = false) {
+		options.deferUpload = true;
+		return AssetFuture<Model>(pool.Submit([path, options, gamma]() {
+			return new Model(path, options, gamma);
+		}).share());
+	}
+
+	AssetFuture<AnimatedModel> LoadAnimatedModel(const string &path, unsigned int animation = 0, ModelLoadOptions options = ModelLoadOptions(), bool gamma = false) {
+		options.deferUpload = true;
+		return AssetFuture<AnimatedModel>(pool.Submit([path, options, animation, gamma]() {
+			return new AnimatedModel(path, options, animation, gamma);
+		}).share());
+	}
+
+	// Asset shared by every user of a file: asking again for the same path, 'animated' flag and
+	// import options returns the request already made instead of importing the file twice. Other
+	// options import the file again, into an asset of its own.
+	SharedAssetFuture<ModelAsset> LoadModelAsset(const string &path, ModelLoadOptions options = ModelLoadOptions(), bool animated = false) {
+		string key = CanonicalPath(path) + (animated ? "|animated" : "") + "|" + optionsKey(options);
+		map<string, shared_future<shared_ptr<ModelAsset> > >::iterator found = modelAssets.find(key);
+		if (found != modelAssets.end())
+			return SharedAssetFuture<ModelAsset>(found->second);
+
+		options.deferUpload = true;
+		shared_future<shared_ptr<ModelAsset> > request = pool.Submit([path, options, animated]() {
+			return make_shared<ModelAsset>(path, options, animated);
+		}).share();
+		modelAssets[key] = request;
+		return SharedAssetFuture<ModelAsset>(request);
+	}
+
+	// decodes an image without creating any GL object
+	future<TextureImage> LoadImage(const string &path) {
+		return pool.Submit([path]() {
+			return LoadTextureImage(path);
+		});
+	}
+
+	unsigned int NumThreads() const { return pool.Size(); }
+
+private:
+	ThreadPool pool;
+	map<string, shared_future<shared_ptr<ModelAsset> > > modelAssets; // by canonical path and options
+
+	// the options that change the geometry an asset ends up with
+	static string optionsKey(const ModelLoadOptions &options) {
+		char key[96];
+		snprintf(key, sizeof(key), "%08x|%d%d%d%d|%a|%u|%u|%d", options.vertexFormat.Key(), options.weldVertices, options.optimizeMeshes,
+			options.buildMeshlets, options.mergeGeometry, options.weldEpsilon, options.lodLevels, options.maxInfluences,
+			(int)options.cpuData);
+		return key;
+	}
+};
+
+#endif
@@ -0,0 +1,364 @@
+#ifndef ASSETPACK_H
+#define ASSETPACK_H
+
+#include <lz4block.h>
+#include <mappedfile.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+using namespace std;
+
+// Asset pack written by the AssetPacker tool ("assets.pack" in bin/): every file of models/,
+// textures/ and shaders/ in one file, so a cold start opens one file instead of hundreds.
+//
+// Layout: AssetPackHeader, the file data, then the table of contents: AssetPackEntry records,
+// a hash table of slots (entry index + 1, 0 for empty, linear probing on the path hash) and the
+// entry names. Entries are compressed with LZ4 when it saves at least an eighth of their size;
+// the ones stored as they are start on a page boundary, so they are used straight from the
+// mapping of the pack.
+#define ASSET_PACK_MAGIC          "APAK"
+#define ASSET_PACK_VERSION        1
+#define ASSET_PACK_PAGE           4096
+#define ASSET_PACK_ALIGNMENT      16
+#define ASSET_PACK_STORED         0
+#define ASSET_PACK_LZ4            1
+
+struct AssetPackHeader
+{
+	char     magic[4];
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t slotCount;     // power of two, at least twice entryCount
+	uint64_t entriesOffset;
+	uint64_t slotsOffset;
+	uint64_t namesOffset;
+	uint64_t namesSize;
+};
+
+struct AssetPackEntry
+{
+	uint64_t pathHash;     // PackPathHash of the name
+	uint64_t offset;
+	uint64_t storedSize;   // bytes in the pack
+	uint64_t size;         // bytes once decompressed
+	int64_t  modifiedTime; // of the source file when it was packed
+	uint32_t nameOffset;   // in the names block
+	uint32_t nameLength;
+	uint32_t compression;  // ASSET_PACK_STORED or ASSET_PACK_LZ4
+	uint32_t reserved;
+};
+
+// A path as a string only, no file system access: forward slashes, no "." components and the
+// ".." ones resolved against what precedes them ("models/a/../b.png" is "models/b.png")
+inline string NormalizePath(const string &path)
+{
+	string slashed = path;
+	replace(slashed.begin(), slashed.end(), '\\', '/');
+
+	vector<string> parts;
+	size_t start = 0;
+	while (start <= slashed.size()) {
+		size_t end = slashed.find('/', start);
+		if (end == string::npos) end = slashed.size();
+		string part = slashed.substr(start, end - start);
+		if (part == "..") {
+			if (!parts.empty() && parts.back() != ".." && !parts.back().empty()) parts.pop_back();
+			else parts.push_back(part);
+		}
+		else if (part != "." && !(part.empty() && !parts.empty()))
+			parts.push_back(part);
+		start = end + 1;
+	}
+	string normalized;
+	for (unsigned int i = 0; i < parts.size(); i++) {
+		if (i > 0) normalized += '/';
+		normalized += parts[i];
+	}
+	return normalized;
+}
+
+// 'path' relative to 'directory', the way the loaders build texture and model paths
+inline string JoinPath(const string &directory, const string &path)
+{
+	if (directory.empty()) return NormalizePath(path);
+	return NormalizePath(directory + '/' + path);
+}
+
+// key of a path in the pack: normalized and lower case (the assets come from Windows, where
+// the FBX files and the disk do not always agree on it)
+inline string PackPathKey(const string &path)
+{
+	string key = NormalizePath(path);
+	transform(key.begin(), key.end(), key.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+	return key;
+}
+
+// 64-bit FNV-1a of the key of a path
+inline uint64_t PackPathHash(const string &key)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < key.size(); i++) {
+		hash ^= (unsigned char)key[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+// a file going into a pack: its name in the pack and where to read it now
+struct AssetPackSource
+{
+	string name;
+	string path;
+};
+
+// What writing a pack did
+struct AssetPackStats
+{
+	unsigned int       files;
+	unsigned int       compressedFiles;
+	unsigned long long bytes;
+	unsigned long long storedBytes;
+
+	AssetPackStats() : files(0), compressedFiles(0), bytes(0), storedBytes(0) {}
+};
+
+class AssetPack
+{
+public:
+	AssetPack() : header(nullptr), entries(nullptr), slots(nullptr), names(nullptr) {}
+
+	// maps a pack, false if it is missing or not valid
+	bool Open(const string &path) {
+		Close();
+		if (!file.Open(path)) return false;
+		if (!parse()) {
+			cout << "WARNING::ASSETPACK:: ignoring invalid pack " << path << endl;
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void Close() {
+		file.Close();
+		header = nullptr;
+		entries = nullptr;
+		slots = nullptr;
+		names = nullptr;
+	}
+
+	bool IsOpen() const { return header != nullptr; }
+
+	unsigned int EntryCount() const { return header ? header->entryCount : 0; }
+	const AssetPackEntry& Entry(unsigned int i) const { return entries[i]; }
+	string EntryName(const AssetPackEntry &entry) const { return string(names + entry.nameOffset, entry.nameLength); }
+
+	// entry of a path (any case, any separators), null if the pack does not have it
+	const AssetPackEntry* Find(const string &path) const {
+		if (!header) return nullptr;
+		string key = PackPathKey(path);
+		uint64_t hash = PackPathHash(key);
+		uint32_t mask = header->slotCount - 1;
+		for (uint32_t slot = (uint32_t)hash & mask; slots[slot] != 0; slot = (slot + 1) & mask) {
+			const AssetPackEntry &entry = entries[slots[slot] - 1];
+			if (entry.pathHash == hash && entry.nameLength == key.size() && sameKey(names + entry.nameOffset, key))
+				return &entry;
+		}
+		return nullptr;
+	}
+
+	// data of an entry stored as it is, inside the mapping; null for compressed entries
+	const unsigned char* StoredData(const AssetPackEntry &entry) const {
+		return entry.compression == ASSET_PACK_STORED ? file.Data() + entry.offset : nullptr;
+	}
+
+	// contents of an entry, decompressed
+	bool Read(const AssetPackEntry &entry, vector<unsigned char> &bytes) const {
+		const unsigned char *data = file.Data() + entry.offset;
+		bytes.resize((size_t)entry.size);
+		if (entry.compression == ASSET_PACK_STORED) {
+			if (entry.size > 0) memcpy(bytes.data(), data, (size_t)entry.size);
+			return true;
+		}
+		if (!Lz4Decompress(data, (size_t)entry.storedSize, bytes.data(), bytes.size())) {
+			cout << "ERROR::ASSETPACK:: damaged entry " << EntryName(entry) << endl;
+			bytes.clear();
+			return false;
+		}
+		return true;
+	}
+
+	// Writes the pack of 'sources' to 'path', LZ4 compressed unless 'compress' is false. The
+	// source modification times go with the entries, for the freshness checks of the caches.
+	static bool Write(const string &path, const vector<AssetPackSource> &sources, bool compress, AssetPackStats &stats) {
+		string tempPath = path + ".tmp";
+		vector<AssetPackEntry> records;
+		string nameBlock;
+		{
+			ofstream out(tempPath.c_str(), ios::binary | ios::trunc);
+			if (!out) {
+				cout << "ERROR::ASSETPACK:: could not create " << tempPath << endl;
+				return false;
+			}
+			AssetPackHeader header;
+			memset(&header, 0, sizeof(header));
+			out.write((const char*)&header, sizeof(header));
+			uint64_t offset = sizeof(header);
+
+			vector<unsigned char> bytes, compressed;
+			for (size_t i = 0; i < sources.size(); i++) {
+				if (!readFile(sources[i].path, bytes)) {
+					cout << "WARNING::ASSETPACK:: could not read " << sources[i].path << endl;
+					continue;
+				}
+				AssetPackEntry entry;
+				memset(&entry, 0, sizeof(entry));
+				string name = NormalizePath(sources[i].name);
+				entry.pathHash = PackPathHash(PackPathKey(name));
+				entry.size = bytes.size();
+				long long modified = 0;
+				GetFileModifiedTime(sources[i].path, modified);
+				entry.modifiedTime = modified;
+				entry.nameOffset = (uint32_t)nameBlock.size();
+				entry.nameLength = (uint32_t)name.size();
+				nameBlock += name;
+
+				const unsigned char *data = bytes.data();
+				size_t size = bytes.size();
+				entry.compression = ASSET_PACK_STORED;
+				if (compress && size > 0) {
+					compressed.resize(Lz4CompressBound(size));
+					size_t compressedSize = Lz4Compress(bytes.data(), size, compressed.data(), compressed.size());
+					if (compressedSize > 0 && compressedSize <= size - size / 8) {
+						entry.compression = ASSET_PACK_LZ4;
+						data = compressed.data();
+						size = compressedSize;
+					}
+				}
+				pad(out, offset, entry.compression == ASSET_PACK_STORED ? ASSET_PACK_PAGE : ASSET_PACK_ALIGNMENT);
+				entry.offset = offset;
+				entry.storedSize = size;
+				out.write((const char*)data, size);
+				offset += size;
+				records.push_back(entry);
+
+				stats.files++;
+				stats.compressedFiles += entry.compression == ASSET_PACK_LZ4 ? 1 : 0;
+				stats.bytes += entry.size;
+				stats.storedBytes += entry.storedSize;
+			}
+
+			// table of contents
+			uint32_t slotCount = 1;
+			while (slotCount < records.size() * 2) slotCount <<= 1;
+			vector<uint32_t> slotTable(slotCount, 0);
+			for (uint32_t i = 0; i < records.size(); i++) {
+				uint32_t slot = (uint32_t)records[i].pathHash & (slotCount - 1);
+				while (slotTable[slot] != 0) slot = (slot + 1) & (slotCount - 1);
+				slotTable[slot] = i + 1;
+			}
+
+			pad(out, offset, ASSET_PACK_ALIGNMENT);
+			memcpy(header.magic, ASSET_PACK_MAGIC, 4);
+			header.version = ASSET_PACK_VERSION;
+			header.entryCount = (uint32_t)records.size();
+			header.slotCount = slotCount;
+			header.entriesOffset = offset;
+			out.write((const char*)records.data(), records.size() * sizeof(AssetPackEntry));
+			offset += records.size() * sizeof(AssetPackEntry);
+			header.slotsOffset = offset;
+			out.write((const char*)slotTable.data(), slotTable.size() * sizeof(uint32_t));
+			offset += slotTable.size() * sizeof(uint32_t);
+			header.namesOffset = offset;
+			header.namesSize = nameBlock.size();
+			out.write(nameBlock.data(), nameBlock.size());
+
+			out.seekp(0);
+			out.write((const char*)&header, sizeof(header));
+			if (!out) {
+				cout << "ERROR::ASSETPACK:: could not write " << tempPath << endl;
+				return false;
+			}
+		}
+
+		// replace the old pack only once the new one is complete
+		remove(path.c_str());
+		if (rename(tempPath.c_str(), path.c_str()) != 0) {
+			remove(tempPath.c_str());
+			return false;
+		}
+		return true;
+	}
+
+private:
+	MappedFile             file;
+	const AssetPackHeader *header;
+	const AssetPackEntry  *entries;
+	const uint32_t        *slots;
+	const char            *names;
+
+	AssetPack(const AssetPack&);
+	AssetPack& operator=(const AssetPack&);
+
+	static bool sameKey(const char *name, const string &key) {
+		for (size_t i = 0; i < key.size(); i++)
+			if ((char)tolower((unsigned char)name[i]) != key[i]) return false;
+		return true;
+	}
+
+	static bool readFile(const string &path, vector<unsigned char> &bytes) {
+		ifstream in(path.c_str(), ios::binary | ios::ate);
+		if (!in) return false;
+		streamoff size = in.tellg();
+		if (size < 0) return false;
+		bytes.resize((size_t)size);
+		in.seekg(0);
+		if (size > 0) in.read((char*)bytes.data(), size);
+		return (bool)in;
+	}
+
+	static void pad(ofstream &out, uint64_t &offset, uint64_t alignment) {
+		static const char zeros[ASSET_PACK_PAGE] = { 0 };
+		uint64_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+		out.write(zeros, (streamsize)(aligned - offset));
+		offset = aligned;
+	}
+
+	bool inRange(uint64_t offset, uint64_t size) const {
+		return offset <= file.Size() && size <= file.Size() - offset;
+	}
+
+	bool parse() {
+		if (file.Size() < sizeof(AssetPackHeader)) return false;
+		const AssetPackHeader *h = (const AssetPackHeader*)file.Data();
+		if (memcmp(h->magic, ASSET_PACK_MAGIC, 4) != 0 || h->version != ASSET_PACK_VERSION) return false;
+		if (h->slotCount == 0 || (h->slotCount & (h->slotCount - 1)) != 0 || h->slotCount <= h->entryCount) return false;
+		if (!inRange(h->entriesOffset, (uint64_t)h->entryCount * sizeof(AssetPackEntry))) return false;
+		if (!inRange(h->slotsOffset, (uint64_t)h->slotCount * sizeof(uint32_t))) return false;
+		if (!inRange(h->namesOffset, h->namesSize)) return false;
+
+		const AssetPackEntry *e = (const AssetPackEntry*)(file.Data() + h->entriesOffset);
+		const uint32_t *s = (const uint32_t*)(file.Data() + h->slotsOffset);
+		for (uint32_t i = 0; i < h->entryCount; i++) {
+			if (!inRange(e[i].offset, e[i].storedSize)) return false;
+			if ((uint64_t)e[i].nameOffset + e[i].nameLength > h->namesSize) return false;
+			if (e[i].compression == ASSET_PACK_STORED ? e[i].storedSize != e[i].size : e[i].compression != ASSET_PACK_LZ4) return false;
+		}
+		for (uint32_t i = 0; i < h->slotCount; i++)
+			if (s[i] > h->entryCount) return false;
+
+		header = h;
+		entries = e;
+		slots = s;
+		names = (const char*)(file.Data() + h->namesOffset);
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef ASSIMPIO_H
+#define ASSIMPIO_H
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+
+#include <virtualfile.h>
+
+#include <string>
+#include <vector>
+#include <string.h>
+using namespace std;
+
+// Lets Assimp read the model files (and whatever they reference) through the
+// VirtualFileSystem: the file is read whole, then served from memory.
+class VirtualIOStream : public Assimp::IOStream
+{
+public:
+	explicit VirtualIOStream(vector<unsigned char> &contents) : position(0) {
+		bytes.swap(contents);
+	}
+
+	size_t Read(void *buffer, size_t size, size_t count) override {
+		if (size == 0) return 0;
+		size_t items = min(count, (bytes.size() - position) / size);
+		memcpy(buffer, bytes.data() + position, items * size);
+		position += items * size;
+		return items;
+	}
+
+	size_t Write(const void*, size_t, size_t) override { return 0; }
+
+	aiReturn Seek(size_t offset, aiOrigin origin) override {
+		size_t target;
+		if (origin == aiOrigin_SET) target = offset;
+		else if (origin == aiOrigin_CUR) target = position + offset;
+		else target = bytes.size() - offset;
+		if (target > bytes.size()) return aiReturn_FAILURE;
+		position = target;
+		return aiReturn_SUCCESS;
+	}
+
+	size_t Tell() const override { return position; }
+	size_t FileSize() const override { return bytes.size(); }
+	void Flush() override {}
+
+private:
+	vector<unsigned char> bytes;
+	size_t                position;
+};
+
+// Read-only: Assimp never writes while importing. Give it to the importer with
+// importer.SetIOHandler(new VirtualIOSystem()), which deletes it.
+class VirtualIOSystem : public Assimp::IOSystem
+{
+public:
+	bool Exists(const char *file) const override {
+		return VirtualFileSystem::Get().Exists(file);
+	}
+
+	char getOsSeparator() const override { return '/'; }
+
+	Assimp::IOStream* Open(const char *file, const char *mode = "rb") override {
+		if (strchr(mode, 'w') != nullptr || strchr(mode, 'a') != nullptr) return nullptr;
+		vector<unsigned char> bytes;
+		if (!VirtualFileSystem::Get().ReadFile(file, bytes)) return nullptr;
+		return new VirtualIOStream(bytes);
+	}
+
+	void Close(Assimp::IOStream *stream) override {
+		delete stream;
+	}
+};
+
+#endif
@@ -0,0 +1,356 @@
+#ifndef BCENCODER_H
+#define BCENCODER_H
+
+#include <texturecontainer.h>
+#include <threadpool.h>
+
+#include <algorithm>
+#include <vector>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BC_ENCODER_SSE2
+#include <emmintrin.h>
+#endif
+
+// CPU encoder for BC1/BC3/BC5/BC7 blocks, used by the TextureBaker tool.
+//
+// Every format is encoded the same way: the endpoints are the extremes of the block along its
+// principal axis and each pixel takes the nearest point of the palette between them. BC7 always
+// uses mode 6 (one subset, RGBA endpoints, 16 levels), which suits the smooth images we ship.
+
+// 4x4 block of pixels, one array per channel so four pixels fit in an SSE register
+struct BlockPixels
+{
+	float c[4][16];
+};
+
+// copies the block (bx, by) of an RGBA8 image, repeating the last row/column past the edges
+inline void LoadBlock(const unsigned char *rgba, unsigned int width, unsigned int height, unsigned int bx, unsigned int by, BlockPixels &block)
+{
+	for (unsigned int y = 0; y < 4; y++) {
+		unsigned int sy = std::min(by * 4 + y, height - 1);
+		for (unsigned int x = 0; x < 4; x++) {
+			unsigned int sx = std::min(bx * 4 + x, width - 1);
+			const unsigned char *pixel = rgba + ((size_t)sy * width + sx) * 4;
+			for (unsigned int c = 0; c < 4; c++)
+				block.c[c][y * 4 + x] = pixel[c];
+		}
+	}
+}
+
+// Nearest of 'steps' evenly spaced points between e0 (index 0) and e1 (index steps-1) for every
+// pixel, using the first 'channels' planes.
+inline void ProjectIndices(const float (*planes)[16], int channels, const float e0[4], const float e1[4], int steps, int indices[16])
+{
+	float dir[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float length2 = 0.0f;
+	for (int c = 0; c < channels; c++) {
+		dir[c] = e1[c] - e0[c];
+		length2 += dir[c] * dir[c];
+	}
+	if (length2 < 1e-6f) {
+		memset(indices, 0, 16 * sizeof(int));
+		return;
+	}
+	float scale = (steps - 1) / length2;
+	for (int c = 0; c < channels; c++)
+		dir[c] *= scale;
+
+#ifdef BC_ENCODER_SSE2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 last = _mm_set1_ps((float)(steps - 1));
+	for (int i = 0; i < 16; i += 4) {
+		__m128 t = zero;
+		for (int c = 0; c < channels; c++) {
+			__m128 d = _mm_sub_ps(_mm_loadu_ps(&planes[c][i]), _mm_set1_ps(e0[c]));
+			t = _mm_add_ps(t, _mm_mul_ps(d, _mm_set1_ps(dir[c])));
+		}
+		t = _mm_min_ps(_mm_max_ps(t, zero), last);
+		_mm_storeu_si128((__m128i*)&indices[i], _mm_cvtps_epi32(t)); // round to nearest
+	}
+#else
+	for (int i = 0; i < 16; i++) {
+		float t = 0.0f;
+		for (int c = 0; c < channels; c++)
+			t += (planes[c][i] - e0[c]) * dir[c];
+		t = std::min(std::max(t, 0.0f), (float)(steps - 1));
+		indices[i] = (int)(t + 0.5f);
+	}
+#endif
+}
+
+// Endpoints of the block along its principal axis (power iteration on the covariance matrix)
+inline void FitEndpoints(const float (*planes)[16], int channels, float e0[4], float e1[4])
+{
+	float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int c = 0; c < channels; c++) {
+		for (int i = 0; i < 16; i++)
+			mean[c] += planes[c][i];
+		mean[c] /= 16.0f;
+	}
+
+	float covariance[4][4] = {};
+	for (int i = 0; i < 16; i++)
+		for (int a = 0; a < channels; a++)
+			for (int b = a; b < channels; b++)
+				covariance[a][b] += (planes[a][i] - mean[a]) * (planes[b][i] - mean[b]);
+	for (int a = 0; a < channels; a++)
+		for (int b = 0; b < a; b++)
+			covariance[a][b] = covariance[b][a];
+
+	float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 8; iteration++) {
+		float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float length = 0.0f;
+		for (int a = 0; a < channels; a++) {
+			for (int b = 0; b < channels; b++)
+				next[a] += covariance[a][b] * axis[b];
+			length = std::max(length, fabsf(next[a]));
+		}
+		if (length < 1e-6f) break; // flat block
+		for (int a = 0; a < channels; a++)
+			axis[a] = next[a] / length;
+	}
+
+	float low = 0.0f, high = 0.0f;
+	for (int i = 0; i < 16; i++) {
+		float t = 0.0f;
+		for (int c = 0; c < channels; c++)
+			t += (planes[c][i] - mean[c]) * axis[c];
+		low = std::min(low, t);
+		high = std::max(high, t);
+	}
+	float length2 = 0.0f;
+	for (int c = 0; c < channels; c++)
+		length2 += axis[c] * axis[c];
+	if (length2 > 0.0f) {
+		low /= length2;
+		high /= length2;
+	}
+
+	for (int c = 0; c < 4; c++) {
+		e0[c] = c < channels ? std::min(std::max(mean[c] + axis[c] * low, 0.0f), 255.0f) : 0.0f;
+		e1[c] = c < channels ? std::min(std::max(mean[c] + axis[c] * high, 0.0f), 255.0f) : 0.0f;
+	}
+}
+
+inline uint16_t PackRGB565(const float color[4])
+{
+	unsigned int r = (unsigned int)(color[0] * 31.0f / 255.0f + 0.5f);
+	unsigned int g = (unsigned int)(color[1] * 63.0f / 255.0f + 0.5f);
+	unsigned int b = (unsigned int)(color[2] * 31.0f / 255.0f + 0.5f);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+inline void UnpackRGB565(uint16_t packed, float color[4])
+{
+	unsigned int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+	color[0] = (float)((r << 3) | (r >> 2));
+	color[1] = (float)((g << 2) | (g >> 4));
+	color[2] = (float)((b << 3) | (b >> 2));
+	color[3] = 255.0f;
+}
+
+inline void EncodeBC1Block(const BlockPixels &block, unsigned char out[8])
+{
+	float e0[4], e1[4];
+	FitEndpoints(block.c, 3, e0, e1);
+	uint16_t c0 = PackRGB565(e0), c1 = PackRGB565(e1);
+	if (c0 < c1) std::swap(c0, c1); // c0 > c1 selects the four colour mode
+
+	uint32_t bits = 0;
+	if (c0 != c1) {
+		float q0[4], q1[4];
+		UnpackRGB565(c0, q0);
+		UnpackRGB565(c1, q1);
+		int t[16];
+		ProjectIndices(block.c, 3, q0, q1, 4, t);
+		// palette order is c0, c1, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1
+		static const uint32_t code[4] = { 0, 2, 3, 1 };
+		for (int i = 0; i < 16; i++)
+			bits |= code[t[i]] << (2 * i);
+	}
+
+	out[0] = (unsigned char)(c0 & 0xFF);
+	out[1] = (unsigned char)(c0 >> 8);
+	out[2] = (unsigned char)(c1 & 0xFF);
+	out[3] = (unsigned char)(c1 >> 8);
+	for (int b = 0; b < 4; b++)
+		out[4 + b] = (unsigned char)(bits >> (8 * b));
+}
+
+// single channel block, shared by the alpha of BC3 and both channels of BC5
+inline void EncodeBC4Block(const float plane[16], unsigned char out[8])
+{
+	float low = 255.0f, high = 0.0f;
+	for (int i = 0; i < 16; i++) {
+		low = std::min(low, plane[i]);
+		high = std::max(high, plane[i]);
+	}
+	int a0 = (int)(high + 0.5f), a1 = (int)(low + 0.5f);
+
+	uint64_t bits = 0;
+	if (a0 > a1) { // a0 > a1 selects the eight value mode
+		float e0[4] = { (float)a0 }, e1[4] = { (float)a1 };
+		int t[16];
+		ProjectIndices((const float (*)[16])plane, 1, e0, e1, 8, t);
+		// palette order is a0, a1, then the six interpolated values from a0 towards a1
+		static const uint64_t code[8] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+		for (int i = 0; i < 16; i++)
+			bits |= code[t[i]] << (3 * i);
+	}
+
+	out[0] = (unsigned char)a0;
+	out[1] = (unsigned char)a1;
+	for (int b = 0; b < 6; b++)
+		out[2 + b] = (unsigned char)(bits >> (8 * b));
+}
+
+inline void EncodeBC3Block(const BlockPixels &block, unsigned char out[16])
+{
+	EncodeBC4Block(block.c[3], out);
+	EncodeBC1Block(block, out + 8);
+}
+
+inline void EncodeBC5Block(const BlockPixels &block, unsigned char out[16])
+{
+	EncodeBC4Block(block.c[0], out);
+	EncodeBC4Block(block.c[1], out + 8);
+}
+
+// appends bits to a 128-bit block, least significant first
+struct BlockBitWriter
+{
+	unsigned char *out;
+	unsigned int   position;
+
+	explicit BlockBitWriter(unsigned char *out) : out(out), position(0) {
+		memset(out, 0, 16);
+	}
+
+	void Write(unsigned int value, unsigned int bits) {
+		for (unsigned int i = 0; i < bits; i++, position++)
+			if (value & (1u << i))
+				out[position >> 3] |= (unsigned char)(1u << (position & 7));
+	}
+};
+
+inline void EncodeBC7Block(const BlockPixels &block, unsigned char out[16])
+{
+	float e[2][4];
+	FitEndpoints(block.c, 4, e[0], e[1]);
+
+	// mode 6 endpoints are 7 bits per channel plus one shared low bit (p-bit) per endpoint
+	unsigned int q[2][4], p[2];
+	float r[2][4];
+	for (int k = 0; k < 2; k++) {
+		float bestError = 1e30f;
+		for (unsigned int pbit = 0; pbit < 2; pbit++) {
+			unsigned int candidate[4];
+			float error = 0.0f;
+			for (int c = 0; c < 4; c++) {
+				int v = (int)((e[k][c] - pbit) * 0.5f + 0.5f);
+				candidate[c] = (unsigned int)std::min(std::max(v, 0), 127);
+				float d = (float)(candidate[c] * 2 + pbit) - e[k][c];
+				error += d * d;
+			}
+			if (error < bestError) {
+				bestError = error;
+				p[k] = pbit;
+				for (int c = 0; c < 4; c++) {
+					q[k][c] = candidate[c];
+					r[k][c] = (float)(candidate[c] * 2 + pbit);
+				}
+			}
+		}
+	}
+
+	int t[16];
+	ProjectIndices(block.c, 4, r[0], r[1], 16, t);
+	// the top bit of the first index is implicit (0): swap the endpoints when it would be set
+	if (t[0] & 8) {
+		for (int c = 0; c < 4; c++)
+			std::swap(q[0][c], q[1][c]);
+		std::swap(p[0], p[1]);
+		for (int i = 0; i < 16; i++)
+			t[i] = 15 - t[i];
+	}
+
+	BlockBitWriter writer(out);
+	writer.Write(1 << 6, 7); // mode 6
+	for (int c = 0; c < 4; c++) {
+		writer.Write(q[0][c], 7);
+		writer.Write(q[1][c], 7);
+	}
+	writer.Write(p[0], 1);
+	writer.Write(p[1], 1);
+	writer.Write((unsigned int)t[0], 3);
+	for (int i = 1; i < 16; i++)
+		writer.Write((unsigned int)t[i], 4);
+}
+
+// Compresses an RGBA8 image, block rows spread over numThreads threads (0 = one per core)
+inline void CompressImage(const unsigned char *rgba, unsigned int width, unsigned int height, unsigned int format, vector<unsigned char> &out, unsigned int numThreads = 0)
+{
+	unsigned int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	unsigned int blockBytes = BlockFormatBytes(format);
+	out.resize((size_t)blocksX * blocksY * blockBytes);
+
+	ParallelFor(blocksY, [&](unsigned int by) {
+		BlockPixels block;
+		for (unsigned int bx = 0; bx < blocksX; bx++) {
+			LoadBlock(rgba, width, height, bx, by, block);
+			unsigned char *dst = &out[((size_t)by * blocksX + bx) * blockBytes];
+			switch (format) {
+			case BLOCK_BC1: EncodeBC1Block(block, dst); break;
+			case BLOCK_BC3: EncodeBC3Block(block, dst); break;
+			case BLOCK_BC5: EncodeBC5Block(block, dst); break;
+			case BLOCK_BC7: EncodeBC7Block(block, dst); break;
+			}
+		}
+	}, numThreads);
+}
+
+// Next mip level of an RGBA8 image with a 2x2 box filter
+inline void DownsampleImage(const vector<unsigned char> &src, unsigned int width, unsigned int height, vector<unsigned char> &dst)
+{
+	unsigned int dstWidth = std::max(width / 2, 1u), dstHeight = std::max(height / 2, 1u);
+	dst.resize((size_t)dstWidth * dstHeight * 4);
+	for (unsigned int y = 0; y < dstHeight; y++) {
+		unsigned int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+		for (unsigned int x = 0; x < dstWidth; x++) {
+			unsigned int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+			for (unsigned int c = 0; c < 4; c++) {
+				unsigned int sum = src[((size_t)y0 * width + x0) * 4 + c] + src[((size_t)y0 * width + x1) * 4 + c]
+					+ src[((size_t)y1 * width + x0) * 4 + c] + src[((size_t)y1 * width + x1) * 4 + c];
+				dst[((size_t)y * dstWidth + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+// Compresses an RGBA8 image and its whole mip chain, down to 1x1
+inline void CompressTexture(const unsigned char *rgba, unsigned int width, unsigned int height, unsigned int format, CompressedTexture &texture, unsigned int numThreads = 0)
+{
+	texture.format = format;
+	texture.width = width;
+	texture.height = height;
+	texture.levels.clear();
+
+	vector<unsigned char> level(rgba, rgba + (size_t)width * height * 4), next;
+	for (;;) {
+		texture.levels.push_back(vector<unsigned char>());
+		CompressImage(level.data(), width, height, format, texture.levels.back(), numThreads);
+		if (width == 1 && height == 1) break;
+
+		DownsampleImage(level, width, height, next);
+		level.swap(next);
+		width = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+	}
+}
+
+#endif
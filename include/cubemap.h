@@ -15,6 +15,9 @@
 #include <vector>
 #include <stdlib.h>
 #include <shader_m.h>
+#include <modelstructs.h>
+#include <texturecache.h>
+#include <loadprofiler.h>
 
 using namespace std;
 
@@ -82,49 +85,70 @@ public:
 	}
 
 	~CubeMap() {
-	
+		TextureCache::Get().Release(textureID);
 	}
 
-    void loadCubemap(vector<std::string> faces)
+    // creates the cube map from images already decoded (e.g. by the AssetManager workers)
+    void loadCubemap(const vector<TextureImage> &faces)
     {
+        // the six faces together are the cached texture
+        string key = "cubemap:";
+        vector<uint64_t> hashes;
+        for (unsigned int i = 0; i < faces.size(); i++) {
+            key += CanonicalPath(faces[i].path) + "|";
+            hashes.push_back(faces[i].contentHash);
+        }
+        uint64_t hash = HashBytes(hashes.data(), hashes.size() * sizeof(uint64_t));
+
+        TextureCache::Get().Release(textureID);
+        textureID = TextureCache::Get().Find(key, hash);
+        if (textureID != 0) return;
+
+        // profiled under the folder of the faces, their decoding shows as textures
+        string name = faces.empty() ? string("cubemap") : faces[0].path.substr(0, faces[0].path.find_last_of('/'));
+        LoadTimer timer(name, "cubemap", "upload");
+
         glGenTextures(1, &textureID);
         glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
-        int width, height, nrChannels;
+        unsigned long long bytes = 0;
         for (unsigned int i = 0; i < faces.size(); i++)
         {
-            unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-            if (data)
+            if (faces[i].compressed)
+            {   // face baked by the TextureBaker
+                faces[i].compressed->Upload(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i);
+                bytes += faces[i].compressed->Size();
+            }
+            else if (faces[i].data)
             {
                 glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-                    0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-
-                
-
-                stbi_image_free(data);
+                    0, GL_RGBA, faces[i].width, faces[i].height, 0, GL_RGBA, GL_UNSIGNED_BYTE, faces[i].data);
+                bytes += (unsigned long long)faces[i].width * faces[i].height * 4;
             }
             else
             {
-                std::cout << "Cubemap tex failed to load at path: " << faces[i] << std::endl;
-                stbi_image_free(data);
+                std::cout << "Cubemap tex failed to load at path: " << faces[i].path << std::endl;
             }
         }
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        setParameters();
+        TextureCache::Get().Insert(textureID, key, hash, GL_TEXTURE_CUBE_MAP, bytes);
+        LoadProfiler::Get().AddTextureBytes(name, "cubemap", bytes);
+    }
 
+    void loadCubemap(vector<std::string> faces)
+    {
+        vector<TextureImage> images;
+        for (unsigned int i = 0; i < faces.size(); i++)
+            images.push_back(LoadTextureImage(faces[i]));
+        loadCubemap(images);
     }
 
-    void drawCubeMap(Shader &shad, glm::mat4 &projection, glm::mat4 &view) {
+    // projection and view come from the FrameData uniform block
+    void drawCubeMap(Shader &shad) {
         
         glUseProgram(0);
         glDepthMask(GL_FALSE);
         shad.use();
-        
-        shad.setMat4("projection", projection);
-        shad.setMat4("view", view);
 
         glBindVertexArray(VAO);
         glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
@@ -144,6 +168,15 @@ private:
 
     unsigned int VBO, EBO;
 
+    void setParameters()
+    {
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+
 };
 
 #endif
\ No newline at end of file
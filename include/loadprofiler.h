@@ -0,0 +1,200 @@
+#ifndef LOADPROFILER_H
+#define LOADPROFILER_H
+
+#include <virtualfile.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// What loading one asset (a model, a texture, a cube map or a shader program) cost. The stages
+// of an asset do not overlap, so their sum is the time spent on it. Work done for another asset
+// (a model decoding its textures) shows in both: in the "textures" stage of the model and in the
+// records of the textures.
+struct AssetLoadRecord
+{
+	string                   name;
+	string                   kind;         // "model", "texture", "cubemap" or "shader"
+	map<string, double>      stageMs;      // wall time per stage
+	unsigned long long       bytesRead;    // from disk (source file, mesh cache or texture container)
+	unsigned long long       vertices;
+	unsigned long long       indices;
+	unsigned long long       vertexBytes;  // size of the vertex buffers
+	unsigned long long       textureBytes; // uploaded to the GPU
+
+	AssetLoadRecord() : bytesRead(0), vertices(0), indices(0), vertexBytes(0), textureBytes(0) {}
+
+	double TotalMs() const {
+		double total = 0.0;
+		for (map<string, double>::const_iterator it = stageMs.begin(); it != stageMs.end(); ++it)
+			total += it->second;
+		return total;
+	}
+};
+
+// Collects AssetLoadRecords from the loaders, on any thread. Print() and WriteJSON() are called
+// once the scene is loaded, at the end of Start().
+class LoadProfiler
+{
+public:
+	static LoadProfiler& Get() {
+		static LoadProfiler profiler;
+		return profiler;
+	}
+
+	void AddTime(const string &asset, const char *kind, const char *stage, double ms) {
+		lock_guard<mutex> lock(mtx);
+		record(asset, kind).stageMs[stage] += ms;
+	}
+
+	void AddBytesRead(const string &asset, const char *kind, unsigned long long bytes) {
+		lock_guard<mutex> lock(mtx);
+		record(asset, kind).bytesRead += bytes;
+	}
+
+	void AddGeometry(const string &asset, unsigned long long vertices, unsigned long long indices, unsigned long long vertexBytes) {
+		lock_guard<mutex> lock(mtx);
+		AssetLoadRecord &r = record(asset, "model");
+		r.vertices += vertices;
+		r.indices += indices;
+		r.vertexBytes += vertexBytes;
+	}
+
+	void AddTextureBytes(const string &asset, const char *kind, unsigned long long bytes) {
+		lock_guard<mutex> lock(mtx);
+		record(asset, kind).textureBytes += bytes;
+	}
+
+	// records, slowest first
+	vector<AssetLoadRecord> Records() const {
+		vector<AssetLoadRecord> sorted;
+		{
+			lock_guard<mutex> lock(mtx);
+			for (map<string, AssetLoadRecord>::const_iterator it = records.begin(); it != records.end(); ++it)
+				sorted.push_back(it->second);
+		}
+		sort(sorted.begin(), sorted.end(), [](const AssetLoadRecord &a, const AssetLoadRecord &b) {
+			return a.TotalMs() > b.TotalMs();
+		});
+		return sorted;
+	}
+
+	// one row per asset plus the time of every kind/stage pair over all of them
+	void Print() const {
+		vector<AssetLoadRecord> sorted = Records();
+		map<string, double> byStage;
+
+		cout << "Load profile (" << sorted.size() << " assets):" << endl;
+		cout << left << setw(8) << "kind" << right << setw(10) << "ms" << setw(10) << "read KB" << setw(10) << "verts"
+			<< setw(10) << "indices" << setw(10) << "vtx KB" << setw(10) << "tex KB" << "  asset (stages ms)" << endl;
+		for (size_t i = 0; i < sorted.size(); i++) {
+			const AssetLoadRecord &r = sorted[i];
+			ostringstream stages;
+			stages << fixed << setprecision(1);
+			for (map<string, double>::const_iterator it = r.stageMs.begin(); it != r.stageMs.end(); ++it) {
+				stages << (it == r.stageMs.begin() ? "" : ", ") << it->first << " " << it->second;
+				byStage[r.kind + "/" + it->first] += it->second;
+			}
+			cout << left << setw(8) << r.kind << right << fixed << setprecision(1) << setw(10) << r.TotalMs()
+				<< setw(10) << r.bytesRead / 1024 << setw(10) << r.vertices << setw(10) << r.indices
+				<< setw(10) << r.vertexBytes / 1024 << setw(10) << r.textureBytes / 1024 << "  " << r.name << " (" << stages.str() << ")" << endl;
+		}
+
+		cout << "Load time by stage:" << endl;
+		for (map<string, double>::const_iterator it = byStage.begin(); it != byStage.end(); ++it)
+			cout << "  " << left << setw(24) << it->first << right << setw(10) << it->second << " ms" << endl;
+		cout.unsetf(ios::floatfield);
+		cout << setprecision(6);
+	}
+
+	bool WriteJSON(const string &path) const {
+		vector<AssetLoadRecord> sorted = Records();
+		ofstream out(path.c_str(), ios::trunc);
+		if (!out) {
+			cout << "WARNING::LOADPROFILER:: could not write " << path << endl;
+			return false;
+		}
+
+		out << fixed << setprecision(3);
+		out << "{\n  \"assets\": [\n";
+		for (size_t i = 0; i < sorted.size(); i++) {
+			const AssetLoadRecord &r = sorted[i];
+			out << "    {\"name\": \"" << escape(r.name) << "\", \"kind\": \"" << r.kind << "\", \"totalMs\": " << r.TotalMs()
+				<< ", \"bytesRead\": " << r.bytesRead << ", \"vertices\": " << r.vertices << ", \"indices\": " << r.indices
+				<< ", \"vertexBytes\": " << r.vertexBytes << ", \"textureBytes\": " << r.textureBytes << ", \"stagesMs\": {";
+			for (map<string, double>::const_iterator it = r.stageMs.begin(); it != r.stageMs.end(); ++it)
+				out << (it == r.stageMs.begin() ? "" : ", ") << "\"" << it->first << "\": " << it->second;
+			out << "}}" << (i + 1 < sorted.size() ? "," : "") << "\n";
+		}
+		out << "  ]\n}\n";
+		return (bool)out;
+	}
+
+private:
+	mutable mutex                mtx;
+	map<string, AssetLoadRecord> records; // by kind and name
+
+	LoadProfiler() {}
+
+	AssetLoadRecord& record(const string &asset, const char *kind) {
+		AssetLoadRecord &r = records[string(kind) + ":" + asset];
+		if (r.name.empty()) {
+			r.name = asset;
+			r.kind = kind;
+		}
+		return r;
+	}
+
+	static string escape(const string &text) {
+		string escaped;
+		for (size_t i = 0; i < text.size(); i++) {
+			if (text[i] == '"' || text[i] == '\\') escaped += '\\';
+			escaped += text[i];
+		}
+		return escaped;
+	}
+};
+
+// Adds the wall time between its construction and destruction to a stage of an asset
+class LoadTimer
+{
+public:
+	LoadTimer(const string &asset, const char *kind, const char *stage)
+		: asset(asset), kind(kind), stage(stage), start(chrono::steady_clock::now()), stopped(false) {}
+
+	~LoadTimer() { Stop(); }
+
+	// records the time so far, for a stage that ends before the scope does
+	void Stop() {
+		if (stopped) return;
+		stopped = true;
+		double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		LoadProfiler::Get().AddTime(asset, kind, stage, ms);
+	}
+
+private:
+	string                           asset;
+	const char                      *kind;
+	const char                      *stage;
+	chrono::steady_clock::time_point start;
+	bool                             stopped;
+
+	LoadTimer(const LoadTimer&);
+	LoadTimer& operator=(const LoadTimer&);
+};
+
+// bytes read to load a file (compressed size when it is in an asset pack), 0 if it can not be opened
+inline unsigned long long FileSizeOnDisk(const string &path)
+{
+	return VirtualFileSystem::Get().StoredSize(path);
+}
+
+#endif
@@ -0,0 +1,172 @@
+#ifndef LZ4BLOCK_H
+#define LZ4BLOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+using namespace std;
+
+// LZ4 block format
+// ----------------
+// The raw block format of LZ4 (no frame, no checksum), enough for the entries of an asset pack,
+// whose sizes are known from the table of contents. A block is a list of sequences: a token
+// (literal count in the high nibble, match length - 4 in the low one, 15 meaning "more bytes
+// follow, 255 at a time"), the literals, a 16-bit little endian offset back into the output and
+// the rest of the match length. The last sequence has literals only; the last 5 bytes are always
+// literals and no match starts in the last 12.
+//
+// The compressor is the greedy single-probe one, fast rather than tight; the decompressor checks
+// every length and offset against both buffers, so a damaged pack fails instead of overrunning.
+
+#define LZ4_MIN_MATCH     4
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MF_LIMIT      12
+#define LZ4_MAX_OFFSET    65535
+#define LZ4_HASH_BITS     16
+
+// largest size the compression of 'size' bytes can take
+inline size_t Lz4CompressBound(size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+inline uint32_t lz4Read32(const unsigned char *p)
+{
+	uint32_t value;
+	memcpy(&value, p, 4);
+	return value;
+}
+
+// writes a length continuation (the part over 15), false when it does not fit
+inline bool lz4WriteLength(unsigned char *&out, const unsigned char *outEnd, size_t length)
+{
+	while (length >= 255) {
+		if (out >= outEnd) return false;
+		*out++ = 255;
+		length -= 255;
+	}
+	if (out >= outEnd) return false;
+	*out++ = (unsigned char)length;
+	return true;
+}
+
+// one sequence: 'literalCount' bytes from 'literals', then a match (matchLength 0 for the last one)
+inline bool lz4WriteSequence(unsigned char *&out, const unsigned char *outEnd, const unsigned char *literals, size_t literalCount,
+	size_t offset, size_t matchLength)
+{
+	if (out >= outEnd) return false;
+	unsigned char *token = out++;
+	*token = (unsigned char)((literalCount >= 15 ? 15 : literalCount) << 4);
+	if (literalCount >= 15 && !lz4WriteLength(out, outEnd, literalCount - 15)) return false;
+	if ((size_t)(outEnd - out) < literalCount) return false;
+	memcpy(out, literals, literalCount);
+	out += literalCount;
+	if (matchLength == 0) return true;
+
+	if (outEnd - out < 2) return false;
+	*out++ = (unsigned char)(offset & 0xFF);
+	*out++ = (unsigned char)(offset >> 8);
+	size_t length = matchLength - LZ4_MIN_MATCH;
+	*token |= (unsigned char)(length >= 15 ? 15 : length);
+	if (length >= 15 && !lz4WriteLength(out, outEnd, length - 15)) return false;
+	return true;
+}
+
+// Compresses 'src' into 'dst' and returns the compressed size, 0 if it does not fit in
+// 'dstCapacity' (Lz4CompressBound always does)
+inline size_t Lz4Compress(const unsigned char *src, size_t srcSize, unsigned char *dst, size_t dstCapacity)
+{
+	unsigned char *out = dst;
+	const unsigned char *outEnd = dst + dstCapacity;
+	size_t anchor = 0;
+
+	if (srcSize > LZ4_MF_LIMIT) {
+		vector<uint32_t> table((size_t)1 << LZ4_HASH_BITS, 0); // last position of every hashed 4 bytes
+		const size_t matchLimit = srcSize - LZ4_LAST_LITERALS; // matches end before it
+		const size_t searchEnd = srcSize - LZ4_MF_LIMIT;       // and start up to it
+		size_t pos = 0;
+		unsigned int misses = 0;
+		while (pos <= searchEnd) {
+			uint32_t sequence = lz4Read32(src + pos);
+			uint32_t slot = (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+			size_t candidate = table[slot];
+			table[slot] = (uint32_t)pos;
+			if (candidate < pos && pos - candidate <= LZ4_MAX_OFFSET && lz4Read32(src + candidate) == sequence) {
+				// back over the literals while the bytes before still match
+				while (pos > anchor && candidate > 0 && src[pos - 1] == src[candidate - 1]) {
+					pos--;
+					candidate--;
+				}
+				size_t length = LZ4_MIN_MATCH;
+				while (pos + length < matchLimit && src[candidate + length] == src[pos + length])
+					length++;
+				if (!lz4WriteSequence(out, outEnd, src + anchor, pos - anchor, pos - candidate, length)) return 0;
+				pos += length;
+				anchor = pos;
+				misses = 0;
+				continue;
+			}
+			// data that does not compress is skipped faster and faster
+			pos += 1 + (misses++ >> 6);
+		}
+	}
+
+	if (!lz4WriteSequence(out, outEnd, src + anchor, srcSize - anchor, 0, 0)) return 0;
+	return (size_t)(out - dst);
+}
+
+// Decompresses a block into exactly 'dstSize' bytes, false if the block is damaged
+inline bool Lz4Decompress(const unsigned char *src, size_t srcSize, unsigned char *dst, size_t dstSize)
+{
+	const unsigned char *in = src, *inEnd = src + srcSize;
+	unsigned char *out = dst, *outEnd = dst + dstSize;
+	while (in < inEnd) {
+		unsigned int token = *in++;
+
+		size_t literals = token >> 4;
+		if (literals == 15) {
+			unsigned int more;
+			do {
+				if (in >= inEnd) return false;
+				more = *in++;
+				literals += more;
+			} while (more == 255);
+		}
+		if (literals > (size_t)(inEnd - in) || literals > (size_t)(outEnd - out)) return false;
+		memcpy(out, in, literals);
+		out += literals;
+		in += literals;
+		if (in == inEnd) break; // the last sequence has no match
+
+		if (inEnd - in < 2) return false;
+		size_t offset = (size_t)in[0] | ((size_t)in[1] << 8);
+		in += 2;
+		if (offset == 0 || offset > (size_t)(out - dst)) return false;
+
+		size_t length = token & 15;
+		if (length == 15) {
+			unsigned int more;
+			do {
+				if (in >= inEnd) return false;
+				more = *in++;
+				length += more;
+			} while (more == 255);
+		}
+		length += LZ4_MIN_MATCH;
+		if (length > (size_t)(outEnd - out)) return false;
+
+		const unsigned char *match = out - offset;
+		if (offset >= length)
+			memcpy(out, match, length);
+		else {
+			// overlapping: the match repeats the bytes it is writing
+			for (size_t i = 0; i < length; i++)
+				out[i] = match[i];
+		}
+		out += length;
+	}
+	return out == outEnd;
+}
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+// glad defines APIENTRY too; windows.h gives it the same meaning
+#ifdef APIENTRY
+#undef APIENTRY
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file. The view stays valid until Close()
+// or until the object is destroyed.
+class MappedFile
+{
+public:
+	MappedFile() : m_data(nullptr), m_size(0)
+#ifdef _WIN32
+		, m_file(INVALID_HANDLE_VALUE), m_mapping(NULL)
+#else
+		, m_fd(-1)
+#endif
+	{
+	}
+
+	~MappedFile() {
+		Close();
+	}
+
+	bool Open(const std::string &path) {
+		Close();
+#ifdef _WIN32
+		m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (m_file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(m_file, &fileSize) || fileSize.QuadPart == 0) {
+			Close();
+			return false;
+		}
+		m_size = (size_t)fileSize.QuadPart;
+
+		m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (m_mapping == NULL) {
+			Close();
+			return false;
+		}
+		m_data = (const unsigned char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		m_fd = open(path.c_str(), O_RDONLY);
+		if (m_fd < 0) return false;
+
+		struct stat st;
+		if (fstat(m_fd, &st) != 0 || st.st_size == 0) {
+			Close();
+			return false;
+		}
+		m_size = (size_t)st.st_size;
+
+		void *view = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+		m_data = (view == MAP_FAILED) ? nullptr : (const unsigned char*)view;
+#endif
+		if (m_data == nullptr) {
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void Close() {
+#ifdef _WIN32
+		if (m_data) UnmapViewOfFile(m_data);
+		if (m_mapping != NULL) CloseHandle(m_mapping);
+		if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+		m_mapping = NULL;
+		m_file = INVALID_HANDLE_VALUE;
+#else
+		if (m_data) munmap((void*)m_data, m_size);
+		if (m_fd >= 0) close(m_fd);
+		m_fd = -1;
+#endif
+		m_data = nullptr;
+		m_size = 0;
+	}
+
+	bool IsOpen() const { return m_data != nullptr; }
+	const unsigned char* Data() const { return m_data; }
+	size_t Size() const { return m_size; }
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	const unsigned char *m_data;
+	size_t               m_size;
+#ifdef _WIN32
+	HANDLE m_file;
+	HANDLE m_mapping;
+#else
+	int    m_fd;
+#endif
+};
+
+// Last modification time of a file, false if the file does not exist.
+inline bool GetFileModifiedTime(const std::string &path, long long &time)
+{
+#ifdef _WIN32
+	struct _stat64 st;
+	if (_stat64(path.c_str(), &st) != 0) return false;
+#else
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) return false;
+#endif
+	time = (long long)st.st_mtime;
+	return true;
+}
+
+#endif
@@ -7,95 +7,311 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <shader.h>
+#include <vertexlayout.h>
+#include <meshlet.h>
+#include <textureredirects.h>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <map>
 #include <vector>
 using namespace std;
 
 // Bones information
 #define MAX_NUM_BONES 4
 
-struct Vertex {
-    // position
-    glm::vec3 Position;
-    // normal
-    glm::vec3 Normal;
-    // texCoords
-    glm::vec2 TexCoords;
-    // tangent
-    glm::vec3 Tangent;
-    // bitangent
-    glm::vec3 Bitangent;
-	// bone data
-	glm::vec4 IDs1; // 4 bones
-	glm::vec4 IDs2; // 4 bones
-	glm::vec4 IDs3; // 4 bones
-	glm::vec4 Weights1; 
-	glm::vec4 Weights2;
-	glm::vec4 Weights3;
-};
-
 struct Texture {
     unsigned int id;
     string type;
     string path;
 };
 
+// index type of the element buffer: 16-bit whenever every vertex can be addressed with it
+inline GLenum MeshIndexType(unsigned int vertexCount)
+{
+    return vertexCount < 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+inline size_t MeshIndexSize(GLenum indexType)
+{
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+}
+
+// binds 'textures' to the first texture units and points the samplers texture_diffuseN,
+// texture_specularN... of the shader at them. The textures of a type found in textureOverrides
+// are replaced by the given one.
+inline void BindMeshTextures(const Shader &shader, const vector<Texture> &textures, const map<string, unsigned int> *textureOverrides)
+{
+    unsigned int diffuseNr  = 1;
+    unsigned int specularNr = 1;
+    unsigned int normalNr   = 1;
+    unsigned int heightNr   = 1;
+    for(unsigned int i = 0; i < textures.size(); i++)
+    {
+        glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
+        // retrieve texture number (the N in diffuse_textureN)
+        string number;
+        string name = textures[i].type;
+        if(name == "texture_diffuse")
+            number = std::to_string(diffuseNr++);
+        else if(name == "texture_specular")
+            number = std::to_string(specularNr++); // transfer unsigned int to stream
+        else if(name == "texture_normal")
+            number = std::to_string(normalNr++); // transfer unsigned int to stream
+         else if(name == "texture_height")
+            number = std::to_string(heightNr++); // transfer unsigned int to stream
+
+        // now set the sampler to the correct texture unit (skipped when it already points there)
+        shader.setInt(name + number, (int)i);
+        // and finally bind the texture (a streamed placeholder may have been redirected to a
+        // cached copy of the same image)
+        unsigned int id = TextureRedirects::Get().Resolve(textures[i].id);
+        if (textureOverrides != nullptr) {
+            map<string, unsigned int>::const_iterator replacement = textureOverrides->find(name);
+            if (replacement != textureOverrides->end())
+                id = replacement->second;
+        }
+        glBindTexture(GL_TEXTURE_2D, id);
+    }
+}
+
+// CPU copy of its geometry a mesh keeps once the buffers are uploaded
+enum MeshCpuData
+{
+    MESH_CPU_KEEP,      // the vertices and indices, as imported
+    MESH_CPU_COLLISION, // positions and indices only, for picking and collision
+    MESH_CPU_RELEASE    // nothing: the GL buffers are the only copy
+};
+
+// Bytes a mesh, a model or a batch takes. Textures are shared between models and are not
+// counted here, the TextureCache reports them.
+struct GeometryMemory
+{
+    size_t cpuBytes; // vertices, indices, levels of detail and meshlets kept in RAM
+    size_t gpuBytes; // vertex and element buffers
+
+    GeometryMemory() : cpuBytes(0), gpuBytes(0) {}
+
+    void Add(const GeometryMemory &other)
+    {
+        cpuBytes += other.cpuBytes;
+        gpuBytes += other.gpuBytes;
+    }
+
+    void Print(const string &name) const
+    {
+        cout << "Memory: " << name << ": CPU " << cpuBytes / 1024 << " KB, GPU " << gpuBytes / 1024 << " KB" << endl;
+    }
+};
+
+// One level of detail: a range of the mesh indices over the same vertices, and how far (in
+// object units) its surface may be from the full one
+struct MeshLod {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    float error;
+
+    MeshLod() : indexOffset(0), indexCount(0), error(0.0f) {}
+    MeshLod(unsigned int indexOffset, unsigned int indexCount, float error) : indexOffset(indexOffset), indexCount(indexCount), error(error) {}
+};
+
 class Mesh {
 public:
     /*  Mesh Data  */
     vector<Vertex> vertices;
-    vector<unsigned int> indices;
+    vector<unsigned int> indices; // every LOD, one after the other
+    vector<glm::vec3> positions;  // with MESH_CPU_COLLISION, what is left of the vertices
     vector<Texture> textures;
     unsigned int VAO;
+    unsigned int vertexCount;
+    unsigned int indexCount;
+    GLenum indexType; // of the element buffer, the CPU indices are always 32-bit
+
+    // how the vertices are stored in the vertex buffer
+    VertexLayout layout;
+
+    // object space bounding box
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+
+    // levels of detail, the full mesh first (the only one unless the import built a chain)
+    vector<MeshLod> lods;
+
+    // clusters of the first LOD, empty unless the import built them
+    vector<Meshlet> meshlets;
 
     /*  Functions  */
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // constructor, with upload = false the GL buffers are created later by Upload(). 'lods' splits
+    // the indices into levels of detail, empty for a single one. The arrays are taken by value and
+    // moved in: pass them with std::move and the import hands its data over without a copy.
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, bool upload = true,
+         const VertexFormat &format = VertexFormat(), vector<MeshLod> lods = vector<MeshLod>(), vector<Meshlet> meshlets = vector<Meshlet>())
+        : VAO(0), vertexCount((unsigned int)vertices.size()), indexCount((unsigned int)indices.size()),
+          indexType(MeshIndexType((unsigned int)vertices.size())), VBO(0), EBO(0)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->textures = std::move(textures);
+        this->layout = VertexLayout::For(format, this->vertices.data(), vertexCount);
+        this->lods = std::move(lods);
+        if (this->lods.empty())
+            this->lods.push_back(MeshLod(0, indexCount, 0.0f));
+        this->meshlets = std::move(meshlets);
+
+        computeBounds();
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        if (upload)
+            Upload();
+    }
+
+    // constructor for baked data: the buffers are filled straight from the given vertices, already
+    // packed with 'layout' (usually a mapped mesh cache), and no CPU copy of them is kept.
+    Mesh(const unsigned char *vertexData, unsigned int vertexCount, const VertexLayout &layout, const unsigned int *indexData, unsigned int indexCount,
+         vector<Texture> textures, glm::vec3 boundsMin, glm::vec3 boundsMax, vector<MeshLod> lods = vector<MeshLod>(),
+         vector<Meshlet> meshlets = vector<Meshlet>())
+        : VAO(0), vertexCount(vertexCount), indexCount(indexCount), indexType(MeshIndexType(vertexCount)), layout(layout), VBO(0), EBO(0)
+    {
+        this->textures = std::move(textures);
+        this->boundsMin = boundsMin;
+        this->boundsMax = boundsMax;
+        this->lods = std::move(lods);
+        if (this->lods.empty())
+            this->lods.push_back(MeshLod(0, indexCount, 0.0f));
+        this->meshlets = std::move(meshlets);
+
+        setupMesh(vertexData, vertexCount, indexData, indexCount);
+    }
+
+    // creates the GL buffers of a mesh constructed without upload, must run on the thread that owns the context
+    void Upload()
+    {
+        if (VAO != 0) return;
+        if (vertices.empty() && vertexCount > 0)
+        {
+            cout << "WARNING::MESH:: the CPU vertices were released, nothing to upload" << endl;
+            return;
+        }
+        vector<unsigned char> packed;
+        PackVertices(packed);
+        setupMesh(packed.data(), vertexCount, indices.data(), (unsigned int)indices.size());
+    }
+
+    bool IsUploaded() const { return VAO != 0; }
+
+    // the GL buffers, to copy them into a ModelGeometry
+    unsigned int VertexBuffer() const { return VBO; }
+    unsigned int IndexBuffer() const { return EBO; }
+
+    // deletes the GL buffers and vertex arrays once a ModelGeometry holds a copy of them; the mesh
+    // is then drawn through it, Upload() would create them again from the CPU vertices
+    void ReleaseBuffers()
+    {
+        for (map<unsigned int, unsigned int>::iterator it = vertexArrays.begin(); it != vertexArrays.end(); ++it)
+            glDeleteVertexArrays(1, &it->second);
+        vertexArrays.clear();
+        if (VAO != 0) glDeleteVertexArrays(1, &VAO);
+        if (VBO != 0) glDeleteBuffers(1, &VBO);
+        if (EBO != 0) glDeleteBuffers(1, &EBO);
+        VAO = VBO = EBO = 0;
     }
 
+    // Frees the CPU copy of the geometry once the GL buffers (or a ModelGeometry) hold it: the
+    // vertices go, and with MESH_CPU_RELEASE the indices too. The memory is given back, not only
+    // cleared. Bounds, levels of detail and meshlets stay, the draws need them.
+    void ReleaseCpuData(MeshCpuData policy)
+    {
+        if (policy == MESH_CPU_KEEP) return;
+        if (policy == MESH_CPU_COLLISION && positions.empty())
+        {
+            positions.reserve(vertices.size());
+            for (unsigned int i = 0; i < vertices.size(); i++)
+                positions.push_back(vertices[i].Position);
+        }
+        vector<Vertex>().swap(vertices);
+        if (policy == MESH_CPU_RELEASE)
+        {
+            vector<unsigned int>().swap(indices);
+            vector<glm::vec3>().swap(positions);
+        }
+    }
+
+    // the collision copy of a mesh built from baked data: 'positionStream' is the position
+    // stream of the packed vertices (tightly packed vec3s), 'indexData' all its indices
+    void SetCollisionData(const unsigned char *positionStream, const unsigned int *indexData)
+    {
+        positions.resize(vertexCount);
+        if (vertexCount > 0)
+            memcpy(positions.data(), positionStream, (size_t)vertexCount * sizeof(glm::vec3));
+        indices.assign(indexData, indexData + indexCount);
+    }
+
+    GeometryMemory Memory() const
+    {
+        GeometryMemory memory;
+        memory.cpuBytes = vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int) + positions.capacity() * sizeof(glm::vec3)
+            + lods.capacity() * sizeof(MeshLod) + meshlets.capacity() * sizeof(Meshlet);
+        if (VBO != 0)
+            memory.gpuBytes = VertexBytes() + IndexBytes();
+        return memory;
+    }
+
+    // the CPU vertices encoded with the mesh layout, as they go to the vertex buffer
+    void PackVertices(vector<unsigned char> &packed) const
+    {
+        packed.resize(layout.Size((unsigned int)vertices.size()));
+        if (!vertices.empty())
+            layout.Pack(vertices.data(), (unsigned int)vertices.size(), packed.data());
+    }
+
+    // bytes taken by the vertex buffer
+    size_t VertexBytes() const { return layout.Size(vertexCount); }
+
+    // bytes taken by the element buffer
+    size_t IndexBytes() const { return indexCount * MeshIndexSize(indexType); }
+
     // render the mesh
-    void Draw(Shader shader) 
+    void Draw(Shader shader) const
+    {
+        Draw(shader, nullptr);
+    }
+
+    // render the mesh (at the given level of detail), the textures of a type found in textureOverrides are replaced by the given one.
+    // With a culler the mesh is skipped when it is outside the frustum, and the first LOD only draws the meshlets the camera can see.
+    void Draw(const Shader &shader, const map<string, unsigned int> *textureOverrides, unsigned int lod = 0, const MeshletCuller *culler = nullptr) const
     {
+        lod = min(lod, (unsigned int)lods.size() - 1);
+        GLsizei ranges = 0;
+        if (culler != nullptr)
+        {
+            glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+            if (!culler->SphereVisible(center, glm::length(boundsMax - boundsMin) * 0.5f))
+            {
+                culler->MeshCulled();
+                return;
+            }
+            if (lod == 0 && !meshlets.empty())
+            {
+                ranges = culler->Collect(meshlets, MeshIndexSize(indexType));
+                if (ranges == 0)
+                    return;
+            }
+        }
+
         // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
+        BindMeshTextures(shader, textures, textureOverrides);
+
+        // draw mesh, with the vertex array that only fetches what the shader reads
+        glBindVertexArray(vertexArrayFor(shader.attributeMask));
+        if (ranges > 0)
+            glMultiDrawElements(GL_TRIANGLES, culler->Counts(), indexType, culler->Offsets(), ranges);
+        else
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-             else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            const MeshLod &level = lods[lod];
+            glDrawElements(GL_TRIANGLES, (GLsizei)level.indexCount, indexType, (void*)(uintptr_t)(level.indexOffset * MeshIndexSize(indexType)));
         }
-        
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_INT, 0);
         glBindVertexArray(0);
 
         // always good practice to set everything back to defaults once configured.
@@ -105,11 +321,51 @@ public:
 private:
     /*  Render data  */
     unsigned int VBO, EBO;
+    mutable map<unsigned int, unsigned int> vertexArrays; // VAO per set of attributes, besides the full one
+
+    // VAO enabling only the attributes in 'mask' (the active inputs of a shader), created the
+    // first time a shader with those inputs draws the mesh
+    unsigned int vertexArrayFor(unsigned int mask) const
+    {
+        mask &= layout.AttributeMask();
+        if (VAO == 0 || mask == 0 || mask == layout.AttributeMask())
+            return VAO;
+
+        map<unsigned int, unsigned int>::const_iterator found = vertexArrays.find(mask);
+        if (found != vertexArrays.end())
+            return found->second;
+
+        unsigned int vao;
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        layout.Apply(vertexCount, mask);
+        glBindVertexArray(0);
+        vertexArrays[mask] = vao;
+        return vao;
+    }
 
     /*  Functions    */
+    void computeBounds()
+    {
+        boundsMin = glm::vec3(0.0f);
+        boundsMax = glm::vec3(0.0f);
+        if (vertices.empty()) return;
+
+        boundsMin = boundsMax = vertices[0].Position;
+        for (unsigned int i = 1; i < vertices.size(); i++) {
+            boundsMin = glm::min(boundsMin, vertices[i].Position);
+            boundsMax = glm::max(boundsMax, vertices[i].Position);
+        }
+    }
+
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const unsigned char *vertexData, unsigned int vertexCount, const unsigned int *indexData, unsigned int indexCount)
     {
+        this->vertexCount = vertexCount;
+        this->indexCount = indexCount;
+        this->indexType = MeshIndexType(vertexCount);
 
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
@@ -117,47 +373,22 @@ private:
         glGenBuffers(1, &EBO);
 
         glBindVertexArray(VAO);
-        // load data into vertex buffers
+        // load data into vertex buffers, interleaved as the layout says
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
+        glBufferData(GL_ARRAY_BUFFER, layout.Size(vertexCount), vertexData, GL_STATIC_DRAW);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-		
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);	
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);	
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);	
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-		// vertex bones
-		glEnableVertexAttribArray(5);
-		glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, IDs1));
-		glEnableVertexAttribArray(6);
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, IDs2));
-		glEnableVertexAttribArray(7);
-		glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, IDs3));
-		
-		glEnableVertexAttribArray(8);
-		glVertexAttribPointer(8, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Weights1));
-		glEnableVertexAttribArray(9);
-		glVertexAttribPointer(9, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Weights2));
-		glEnableVertexAttribArray(10);
-		glVertexAttribPointer(10, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Weights3));
+        if (indexType == GL_UNSIGNED_SHORT) {
+            // narrowed copy, half the size in VRAM and in the index fetch
+            vector<unsigned short> shortIndices(indexData, indexData + indexCount);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, IndexBytes(), shortIndices.data(), GL_STATIC_DRAW);
+        }
+        else
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, IndexBytes(), indexData, GL_STATIC_DRAW);
+
+        // set the vertex attribute pointers: only the streams the layout has, a static mesh
+        // enables no bone attribute and a packed one no bitangent
+        layout.Apply(vertexCount);
 
         glBindVertexArray(0);
     }
@@ -0,0 +1,397 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <mesh.h>
+#include <modelstructs.h>
+#include <virtualfile.h>
+
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+using namespace std;
+
+// Baked mesh cache
+// ----------------
+// Imported models are written next to the source file as "<model>.mcache" the first time they are
+// loaded. The file is a flat little-endian image of what processMesh produces, so later runs only
+// have to map it and hand the vertex/index arrays to glBufferData.
+//
+//   MeshCacheHeader
+//   MeshCacheRecord[meshCount]
+//   per mesh: vertices packed with the mesh VertexLayout, unsigned int[indexCount] (every LOD),
+//             texture refs (type, path), MeshLod[lodCount], Meshlet[meshletCount]
+//   bones: name, offset matrix
+//
+// Every array is aligned to MESH_CACHE_ALIGNMENT bytes from the start of the file.
+
+#define MESH_CACHE_MAGIC     "MCHE"
+#define MESH_CACHE_VERSION   8
+#define MESH_CACHE_EXTENSION ".mcache"
+#define MESH_CACHE_ALIGNMENT 16
+
+// header flags
+#define MESH_CACHE_OPTIMIZED 0x1u // meshes went through OptimizeMesh before baking
+#define MESH_CACHE_WELDED    0x2u // and WeldVertices
+#define MESH_CACHE_LODS      0x4u // and BuildLodChain
+#define MESH_CACHE_MESHLETS  0x8u // and BuildMeshlets
+// bits 8..15: the influence limit the skinned vertices were cut to, which has to match exactly
+#define MESH_CACHE_INFLUENCE_SHIFT 8
+// bits 16..23: the levels of detail asked for, which have to match exactly too
+#define MESH_CACHE_LOD_SHIFT       16
+
+inline uint32_t MeshCacheInfluenceFlags(unsigned int maxInfluences)
+{
+	return (maxInfluences & 0xFFu) << MESH_CACHE_INFLUENCE_SHIFT;
+}
+
+inline unsigned int MeshCacheInfluences(uint32_t flags)
+{
+	return (flags >> MESH_CACHE_INFLUENCE_SHIFT) & 0xFFu;
+}
+
+inline uint32_t MeshCacheLodFlags(unsigned int lodLevels)
+{
+	return (lodLevels & 0xFFu) << MESH_CACHE_LOD_SHIFT;
+}
+
+inline unsigned int MeshCacheLods(uint32_t flags)
+{
+	return (flags >> MESH_CACHE_LOD_SHIFT) & 0xFFu;
+}
+
+struct MeshCacheHeader
+{
+	char     magic[4];
+	uint32_t version;
+	uint32_t vertexFormat; // VertexFormat::Key() the meshes were packed with
+	uint32_t meshCount;
+	uint32_t boneCount;
+	uint32_t flags;        // MESH_CACHE_* bits
+	float    weldEpsilon;  // WeldVertices tolerance, with MESH_CACHE_WELDED
+	uint32_t reserved;
+	uint64_t boneOffset;
+	float    globalInverseTransform[16];
+	float    boundsMin[3];
+	float    boundsMax[3];
+};
+
+struct MeshCacheRecord
+{
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t textureCount;
+	uint32_t vertexLayout; // VertexLayout::Key()
+	float    boundsMin[3];
+	float    boundsMax[3];
+	uint32_t lodCount;
+	uint32_t meshletCount;
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint64_t textureOffset;
+	uint64_t lodOffset;
+	uint64_t meshletOffset;
+};
+
+// Texture reference of a baked mesh, resolved by the model against its own texture list.
+struct BakedTexture
+{
+	string type;
+	string path;
+};
+
+// View of one mesh inside the mapping, only valid while the MeshCache is open.
+struct BakedMesh
+{
+	const unsigned char *vertices;
+	unsigned int         vertexCount;
+	VertexLayout         layout;
+	const unsigned int  *indices;
+	unsigned int         indexCount;
+	vector<BakedTexture> textures;
+	glm::vec3            boundsMin;
+	glm::vec3            boundsMax;
+	vector<MeshLod>      lods;
+	vector<Meshlet>      meshlets;
+};
+
+class MeshCache
+{
+public:
+	vector<BakedMesh> meshes;
+	vector<Bone>      bones;
+	glm::mat4         globalInverseTransform;
+	glm::vec3         boundsMin;
+	glm::vec3         boundsMax;
+	VertexFormat      vertexFormat;
+	uint32_t          flags;
+	float             weldEpsilon;
+
+	MeshCache() : globalInverseTransform(1.0f), boundsMin(0.0f), boundsMax(0.0f), flags(0), weldEpsilon(0.0f) {}
+
+	static string CachePath(const string &sourcePath) {
+		return sourcePath + MESH_CACHE_EXTENSION;
+	}
+
+	// The cache is usable when it exists and the source model has not been modified after it was written.
+	static bool IsFresh(const string &sourcePath) {
+		long long sourceTime, cacheTime;
+		if (!VirtualFileSystem::Get().ModifiedTime(CachePath(sourcePath), cacheTime)) return false;
+		if (!VirtualFileSystem::Get().ModifiedTime(sourcePath, sourceTime)) return true; // only the baked file was shipped
+		return sourceTime <= cacheTime;
+	}
+
+	// maps the cache of the given source model, false if it is missing, stale or not valid
+	bool Open(const string &sourcePath) {
+		Close();
+		if (!IsFresh(sourcePath)) return false;
+		if (!file.Open(CachePath(sourcePath))) return false;
+
+		if (!parse()) {
+			cout << "WARNING::MESHCACHE:: ignoring invalid cache " << CachePath(sourcePath) << endl;
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void Close() {
+		meshes.clear();
+		bones.clear();
+		file.Close();
+	}
+
+	// bakes the meshes and bones of a freshly imported model, the vertices packed with 'format'
+	static bool Write(const string &sourcePath, const vector<Mesh> &meshes, const vector<Bone> &bones, const glm::mat4 &globalInverseTransform,
+		const VertexFormat &format, uint32_t flags = 0, float weldEpsilon = 0.0f) {
+		string cachePath = CachePath(sourcePath);
+		string tempPath = cachePath + ".tmp";
+
+		ofstream out(tempPath.c_str(), ios::binary | ios::trunc);
+		if (!out) {
+			cout << "WARNING::MESHCACHE:: could not create " << tempPath << endl;
+			return false;
+		}
+
+		MeshCacheHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, MESH_CACHE_MAGIC, 4);
+		header.version = MESH_CACHE_VERSION;
+		header.vertexFormat = format.Key();
+		header.flags = flags;
+		header.weldEpsilon = weldEpsilon;
+		header.meshCount = (uint32_t)meshes.size();
+		header.boneCount = (uint32_t)bones.size();
+		memcpy(header.globalInverseTransform, glm::value_ptr(globalInverseTransform), sizeof(header.globalInverseTransform));
+
+		vector<MeshCacheRecord> records(meshes.size());
+		uint64_t offset = align(sizeof(MeshCacheHeader) + records.size() * sizeof(MeshCacheRecord));
+
+		// the mesh records and the header are written last, once all offsets are known
+		out.seekp((streamoff)offset);
+		glm::vec3 modelMin(0.0f), modelMax(0.0f);
+		vector<unsigned char> packed;
+		for (unsigned int i = 0; i < meshes.size(); i++) {
+			const Mesh &mesh = meshes[i];
+			MeshCacheRecord &record = records[i];
+			memset(&record, 0, sizeof(record));
+
+			record.vertexCount = (uint32_t)mesh.vertices.size();
+			record.indexCount = (uint32_t)mesh.indices.size();
+			record.textureCount = (uint32_t)mesh.textures.size();
+			record.vertexLayout = mesh.layout.Key();
+			memcpy(record.boundsMin, glm::value_ptr(mesh.boundsMin), sizeof(record.boundsMin));
+			memcpy(record.boundsMax, glm::value_ptr(mesh.boundsMax), sizeof(record.boundsMax));
+
+			modelMin = (i == 0) ? mesh.boundsMin : glm::min(modelMin, mesh.boundsMin);
+			modelMax = (i == 0) ? mesh.boundsMax : glm::max(modelMax, mesh.boundsMax);
+
+			record.vertexOffset = offset;
+			mesh.PackVertices(packed);
+			writeBytes(out, offset, packed.data(), packed.size());
+			record.indexOffset = offset;
+			writeBytes(out, offset, mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+			record.textureOffset = offset;
+			for (unsigned int t = 0; t < mesh.textures.size(); t++) {
+				writeString(out, offset, mesh.textures[t].type);
+				writeString(out, offset, mesh.textures[t].path);
+			}
+			pad(out, offset);
+			record.lodCount = (uint32_t)mesh.lods.size();
+			record.lodOffset = offset;
+			writeBytes(out, offset, mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod));
+			record.meshletCount = (uint32_t)mesh.meshlets.size();
+			record.meshletOffset = offset;
+			writeBytes(out, offset, mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet));
+		}
+
+		header.boneOffset = offset;
+		for (unsigned int b = 0; b < bones.size(); b++) {
+			writeString(out, offset, string(bones[b].name.C_Str()));
+			writeBytes(out, offset, glm::value_ptr(bones[b].offsetMatrix), 16 * sizeof(float));
+		}
+		pad(out, offset);
+
+		memcpy(header.boundsMin, glm::value_ptr(modelMin), sizeof(header.boundsMin));
+		memcpy(header.boundsMax, glm::value_ptr(modelMax), sizeof(header.boundsMax));
+
+		out.seekp(0);
+		out.write((const char*)&header, sizeof(header));
+		if (!records.empty())
+			out.write((const char*)records.data(), records.size() * sizeof(MeshCacheRecord));
+		out.close();
+
+		if (!out) {
+			cout << "WARNING::MESHCACHE:: failed writing " << tempPath << endl;
+			remove(tempPath.c_str());
+			return false;
+		}
+
+		// replace the old cache only once the new one is complete
+		remove(cachePath.c_str());
+		if (rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+			remove(tempPath.c_str());
+			return false;
+		}
+		return true;
+	}
+
+private:
+	VirtualFile file; // mapped, or straight from the asset pack
+
+	static uint64_t align(uint64_t offset) {
+		return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(uint64_t)(MESH_CACHE_ALIGNMENT - 1);
+	}
+
+	static void writeBytes(ofstream &out, uint64_t &offset, const void *data, size_t size) {
+		if (size > 0)
+			out.write((const char*)data, size);
+		offset += size;
+		pad(out, offset);
+	}
+
+	static void writeString(ofstream &out, uint64_t &offset, const string &str) {
+		uint32_t length = (uint32_t)str.size();
+		out.write((const char*)&length, sizeof(length));
+		out.write(str.data(), length);
+		offset += sizeof(length) + length;
+	}
+
+	static void pad(ofstream &out, uint64_t &offset) {
+		static const char zeros[MESH_CACHE_ALIGNMENT] = { 0 };
+		uint64_t aligned = align(offset);
+		out.write(zeros, (streamsize)(aligned - offset));
+		offset = aligned;
+	}
+
+	bool readString(uint64_t &offset, string &str) const {
+		uint32_t length;
+		if (offset + sizeof(length) > file.Size()) return false;
+		memcpy(&length, file.Data() + offset, sizeof(length));
+		offset += sizeof(length);
+		if (offset + length > file.Size()) return false;
+		str.assign((const char*)file.Data() + offset, length);
+		offset += length;
+		return true;
+	}
+
+	bool inRange(uint64_t offset, uint64_t size) const {
+		return offset <= file.Size() && size <= file.Size() - offset;
+	}
+
+	bool parse() {
+		const unsigned char *data = file.Data();
+		if (file.Size() < sizeof(MeshCacheHeader)) return false;
+
+		MeshCacheHeader header;
+		memcpy(&header, data, sizeof(header));
+		if (memcmp(header.magic, MESH_CACHE_MAGIC, 4) != 0 || header.version != MESH_CACHE_VERSION)
+			return false;
+		vertexFormat = VertexFormat::FromKey(header.vertexFormat);
+		if (!vertexFormat.IsValid())
+			return false;
+		flags = header.flags;
+		weldEpsilon = header.weldEpsilon;
+		if (!inRange(sizeof(MeshCacheHeader), (uint64_t)header.meshCount * sizeof(MeshCacheRecord)))
+			return false;
+
+		globalInverseTransform = glm::make_mat4(header.globalInverseTransform);
+		boundsMin = glm::make_vec3(header.boundsMin);
+		boundsMax = glm::make_vec3(header.boundsMax);
+
+		const MeshCacheRecord *records = (const MeshCacheRecord*)(data + sizeof(MeshCacheHeader));
+		meshes.resize(header.meshCount);
+		for (unsigned int i = 0; i < header.meshCount; i++) {
+			const MeshCacheRecord &record = records[i];
+			VertexLayout layout = VertexLayout::FromKey(record.vertexLayout);
+			if (layout.format != vertexFormat)
+				return false;
+			if (!inRange(record.vertexOffset, (uint64_t)record.vertexCount * layout.stride) ||
+				!inRange(record.indexOffset, (uint64_t)record.indexCount * sizeof(unsigned int)))
+				return false;
+
+			BakedMesh &mesh = meshes[i];
+			mesh.vertices = data + record.vertexOffset;
+			mesh.vertexCount = record.vertexCount;
+			mesh.layout = layout;
+			mesh.indices = (const unsigned int*)(data + record.indexOffset);
+			mesh.indexCount = record.indexCount;
+			mesh.boundsMin = glm::make_vec3(record.boundsMin);
+			mesh.boundsMax = glm::make_vec3(record.boundsMax);
+
+			uint64_t offset = record.textureOffset;
+			mesh.textures.resize(record.textureCount);
+			for (unsigned int t = 0; t < record.textureCount; t++) {
+				if (!readString(offset, mesh.textures[t].type) || !readString(offset, mesh.textures[t].path))
+					return false;
+			}
+
+			if (!inRange(record.lodOffset, (uint64_t)record.lodCount * sizeof(MeshLod)))
+				return false;
+			mesh.lods.resize(record.lodCount);
+			if (record.lodCount > 0)
+				memcpy(mesh.lods.data(), data + record.lodOffset, record.lodCount * sizeof(MeshLod));
+			for (unsigned int l = 0; l < record.lodCount; l++) {
+				if ((uint64_t)mesh.lods[l].indexOffset + mesh.lods[l].indexCount > record.indexCount)
+					return false;
+			}
+
+			if (!inRange(record.meshletOffset, (uint64_t)record.meshletCount * sizeof(Meshlet)))
+				return false;
+			mesh.meshlets.resize(record.meshletCount);
+			if (record.meshletCount > 0)
+				memcpy(mesh.meshlets.data(), data + record.meshletOffset, record.meshletCount * sizeof(Meshlet));
+			for (unsigned int m = 0; m < record.meshletCount; m++) {
+				if ((uint64_t)mesh.meshlets[m].indexOffset + mesh.meshlets[m].triangleCount * 3 > record.indexCount)
+					return false;
+			}
+		}
+
+		uint64_t offset = header.boneOffset;
+		bones.resize(header.boneCount);
+		for (unsigned int b = 0; b < header.boneCount; b++) {
+			string name;
+			if (!readString(offset, name) || !inRange(offset, 16 * sizeof(float)))
+				return false;
+			float matrix[16];
+			memcpy(matrix, data + offset, sizeof(matrix));
+			offset += sizeof(matrix);
+
+			bones[b].name = aiString(name);
+			bones[b].offsetMatrix = glm::make_mat4(matrix);
+			bones[b].transformation = glm::mat4(1.0f);
+		}
+		return true;
+	}
+
+	MeshCache(const MeshCache&);
+	MeshCache& operator=(const MeshCache&);
+};
+
+#endif
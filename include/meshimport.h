@@ -0,0 +1,702 @@
+#ifndef MESHIMPORT_H
+#define MESHIMPORT_H
+
+#include <assimp/scene.h>
+
+#include <loadprofiler.h>
+#include <mesh.h>
+#include <meshcache.h>
+#include <meshoptimize.h>
+#include <meshsimplify.h>
+#include <meshweld.h>
+#include <modelstructs.h>
+#include <skeleton.h>
+#include <texturecache.h>
+#include <texturestreamer.h>
+#include <threadpool.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+// influences a Vertex can hold (IDs1..3 / Weights1..3)
+#define MAX_VERTEX_INFLUENCES (3 * MAX_NUM_BONES)
+
+// Import statistics of the skinning data, influences beyond the per-vertex limit are dropped.
+// The weight error of a vertex is the share of its total weight the dropped influences had: the
+// kept weights are scaled up by that much to add up to one again, so it bounds how far the
+// skinned position can move from the one with every influence.
+struct SkinningStats
+{
+	unsigned int maxInfluences;       // per-vertex limit used by the import
+	unsigned int skinnedVertices;     // vertices with at least one influence
+	unsigned int truncatedVertices;   // vertices that had more influences than the limit
+	unsigned int droppedInfluences;   // total influences dropped
+	unsigned int maxDroppedPerVertex;
+	unsigned int usedInfluences;      // most influences any vertex kept
+	float        maxWeightError;
+	double       totalWeightError;    // over the truncated vertices
+
+	SkinningStats() : maxInfluences(MAX_VERTEX_INFLUENCES), skinnedVertices(0), truncatedVertices(0), droppedInfluences(0), maxDroppedPerVertex(0),
+		usedInfluences(0), maxWeightError(0.0f), totalWeightError(0.0) {}
+
+	void Add(const SkinningStats &other) {
+		if (other.skinnedVertices > 0)
+			maxInfluences = other.maxInfluences;
+		skinnedVertices += other.skinnedVertices;
+		truncatedVertices += other.truncatedVertices;
+		droppedInfluences += other.droppedInfluences;
+		maxDroppedPerVertex = std::max(maxDroppedPerVertex, other.maxDroppedPerVertex);
+		usedInfluences = std::max(usedInfluences, other.usedInfluences);
+		maxWeightError = std::max(maxWeightError, other.maxWeightError);
+		totalWeightError += other.totalWeightError;
+	}
+
+	void Print(const string &name) const {
+		if (skinnedVertices == 0) return;
+		cout << "Skinning: " << name << ": " << skinnedVertices << " skinned vertices, up to " << usedInfluences << " influences, "
+			<< truncatedVertices << " over " << maxInfluences << " influences, "
+			<< droppedInfluences << " influences dropped ("
+			<< (float)droppedInfluences / (float)skinnedVertices << " per vertex, max " << maxDroppedPerVertex << ")";
+		if (truncatedVertices > 0)
+			cout << ", weight error max " << maxWeightError << " mean " << totalWeightError / truncatedVertices;
+		cout << endl;
+	}
+};
+
+// Texture used by an imported mesh, before it is resolved into a GL texture by the model.
+struct TextureRef
+{
+	string type;
+	string path;
+};
+
+// CPU result of converting one aiMesh. Filling it touches nothing but the (read only) scene
+// and the structure itself, so several meshes can be converted at the same time.
+struct MeshData
+{
+	vector<Vertex>       vertices;
+	vector<unsigned int> indices;
+	vector<TextureRef>   textures;
+	vector<Bone>         bones;
+	unsigned int         numBones;
+	SkinningStats        skinning;
+	MeshWeldStats        welding;       // filled when the import welds the vertices
+	MeshOptimizationStats optimization; // filled when the import optimizes the meshes
+	vector<MeshLod>      lods;          // filled when the import builds a LOD chain
+	vector<Meshlet>      meshlets;      // filled when the import builds meshlets
+
+	MeshData() : numBones(0) {}
+};
+
+inline glm::mat4 AiToGlm(const aiMatrix4x4 &from)
+{
+	glm::mat4 to;
+
+	to[0][0] = (GLfloat)from.a1; to[0][1] = (GLfloat)from.b1;  to[0][2] = (GLfloat)from.c1; to[0][3] = (GLfloat)from.d1;
+	to[1][0] = (GLfloat)from.a2; to[1][1] = (GLfloat)from.b2;  to[1][2] = (GLfloat)from.c2; to[1][3] = (GLfloat)from.d2;
+	to[2][0] = (GLfloat)from.a3; to[2][1] = (GLfloat)from.b3;  to[2][2] = (GLfloat)from.c3; to[2][3] = (GLfloat)from.d3;
+	to[3][0] = (GLfloat)from.a4; to[3][1] = (GLfloat)from.b4;  to[3][2] = (GLfloat)from.c4; to[3][3] = (GLfloat)from.d4;
+
+	return to;
+}
+
+// Lists the meshes referenced by a node and its children, in the order the old recursive
+// processNode visited them. The mesh order of a model depends only on this walk.
+inline void CollectNodeMeshes(const aiNode *node, const aiScene *scene, vector<const aiMesh*> &out)
+{
+	// the node object only contains indices to index the actual objects in the scene.
+	for (unsigned int i = 0; i < node->mNumMeshes; i++)
+		out.push_back(scene->mMeshes[node->mMeshes[i]]);
+	for (unsigned int i = 0; i < node->mNumChildren; i++)
+		CollectNodeMeshes(node->mChildren[i], scene, out);
+}
+
+inline void CollectMaterialTextures(const aiMaterial *mat, aiTextureType type, const string &typeName, vector<TextureRef> &out)
+{
+	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+	{
+		aiString str;
+		mat->GetTexture(type, i, &str);
+		TextureRef ref;
+		ref.type = typeName;
+		ref.path = str.C_Str();
+		out.push_back(ref);
+	}
+}
+
+// stores influence 'slot' of a vertex in IDs1..3 / Weights1..3
+inline void SetVertexInfluence(Vertex &vertex, unsigned int slot, unsigned int bone, float weight)
+{
+	glm::vec4 *ids = (slot < MAX_NUM_BONES) ? &vertex.IDs1 : (slot < 2 * MAX_NUM_BONES) ? &vertex.IDs2 : &vertex.IDs3;
+	glm::vec4 *weights = (slot < MAX_NUM_BONES) ? &vertex.Weights1 : (slot < 2 * MAX_NUM_BONES) ? &vertex.Weights2 : &vertex.Weights3;
+	(*ids)[slot % MAX_NUM_BONES] = (float)bone;
+	(*weights)[slot % MAX_NUM_BONES] = weight;
+}
+
+struct VertexInfluence
+{
+	unsigned int bone;
+	float        weight;
+};
+
+// Assigns the bone weights of the mesh to its vertices. The aiBone weight lists are scattered once into
+// per-vertex ranges (O(vertices + weights)), then each vertex keeps its 'maxInfluences' largest weights,
+// sorted by weight and renormalized so they still add up to one.
+inline void GatherVertexInfluences(const aiMesh *mesh, vector<Vertex> &vertices, unsigned int maxInfluences, SkinningStats &stats)
+{
+	if (mesh->mNumBones == 0 || vertices.empty()) return;
+
+	const unsigned int numVertices = (unsigned int)vertices.size();
+	maxInfluences = std::min(std::max(maxInfluences, 1u), (unsigned int)MAX_VERTEX_INFLUENCES);
+	stats.maxInfluences = maxInfluences;
+
+	// 1. count the influences of every vertex and turn the counts into offsets
+	vector<unsigned int> offsets(numVertices + 1, 0);
+	for (unsigned int j = 0; j < mesh->mNumBones; j++) {
+		const aiBone *bone = mesh->mBones[j];
+		for (unsigned int k = 0; k < bone->mNumWeights; k++) {
+			unsigned int vertexID = bone->mWeights[k].mVertexId;
+			if (vertexID < numVertices)
+				offsets[vertexID + 1]++;
+		}
+	}
+	for (unsigned int i = 0; i < numVertices; i++)
+		offsets[i + 1] += offsets[i];
+
+	// 2. scatter, bones are visited in order so every range starts sorted by bone index
+	vector<VertexInfluence> influences(offsets[numVertices]);
+	vector<unsigned int> cursor(offsets.begin(), offsets.end() - 1);
+	for (unsigned int j = 0; j < mesh->mNumBones; j++) {
+		const aiBone *bone = mesh->mBones[j];
+		for (unsigned int k = 0; k < bone->mNumWeights; k++) {
+			unsigned int vertexID = bone->mWeights[k].mVertexId;
+			if (vertexID >= numVertices) continue;
+			VertexInfluence &influence = influences[cursor[vertexID]++];
+			influence.bone = j;
+			influence.weight = (float)bone->mWeights[k].mWeight;
+		}
+	}
+
+	// 3. keep the largest influences of every vertex
+	for (unsigned int i = 0; i < numVertices; i++) {
+		VertexInfluence *first = influences.data() + offsets[i];
+		VertexInfluence *last = influences.data() + offsets[i + 1];
+		unsigned int count = (unsigned int)(last - first);
+		if (count == 0) continue;
+
+		stable_sort(first, last, [](const VertexInfluence &a, const VertexInfluence &b) { return a.weight > b.weight; });
+
+		unsigned int kept = std::min(count, maxInfluences);
+		float total = 0.0f;
+		for (unsigned int k = 0; k < kept; k++)
+			total += first[k].weight;
+		float scale = (total > 0.0f) ? 1.0f / total : 0.0f;
+
+		for (unsigned int k = 0; k < kept; k++)
+			SetVertexInfluence(vertices[i], k, first[k].bone, first[k].weight * scale);
+
+		stats.skinnedVertices++;
+		stats.usedInfluences = std::max(stats.usedInfluences, kept);
+		if (count > kept) {
+			float dropped = 0.0f;
+			for (unsigned int k = kept; k < count; k++)
+				dropped += first[k].weight;
+			float error = (total + dropped > 0.0f) ? dropped / (total + dropped) : 0.0f;
+			stats.truncatedVertices++;
+			stats.droppedInfluences += count - kept;
+			stats.maxDroppedPerVertex = std::max(stats.maxDroppedPerVertex, count - kept);
+			stats.maxWeightError = std::max(stats.maxWeightError, error);
+			stats.totalWeightError += error;
+		}
+	}
+}
+
+// 'maxInfluences' caps the bones per vertex (see ModelLoadOptions::maxInfluences)
+inline void ConvertMesh(const aiMesh *mesh, const aiScene *scene, MeshData &data, unsigned int maxInfluences = MAX_VERTEX_INFLUENCES)
+{
+	vector<Vertex> &vertices = data.vertices;
+	vector<unsigned int> &indices = data.indices;
+
+	vertices.reserve(mesh->mNumVertices);
+	data.numBones = mesh->mNumBones;
+
+	// Walk through each of the mesh's vertices
+	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+	{
+		Vertex vertex;
+		glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
+		// positions
+		vector.x = mesh->mVertices[i].x;
+		vector.y = mesh->mVertices[i].y;
+		vector.z = mesh->mVertices[i].z;
+		vertex.Position = vector;
+		// normals
+		vector.x = mesh->mNormals[i].x;
+		vector.y = mesh->mNormals[i].y;
+		vector.z = mesh->mNormals[i].z;
+		vertex.Normal = vector;
+		// texture coordinates
+		if (mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
+		{
+			glm::vec2 vec;
+			// a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't
+			// use models where a vertex can have multiple texture coordinates so we always take the first set (0).
+			vec.x = mesh->mTextureCoords[0][i].x;
+			vec.y = mesh->mTextureCoords[0][i].y;
+			vertex.TexCoords = vec;
+		}
+		else
+			vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+		// tangent
+		vector.x = mesh->mTangents[i].x;
+		vector.y = mesh->mTangents[i].y;
+		vector.z = mesh->mTangents[i].z;
+		vertex.Tangent = vector;
+		// bitangent
+		vector.x = mesh->mBitangents[i].x;
+		vector.y = mesh->mBitangents[i].y;
+		vector.z = mesh->mBitangents[i].z;
+		vertex.Bitangent = vector;
+
+		// Bones, filled by GatherVertexInfluences
+		for (unsigned int pb = 0; pb < MAX_NUM_BONES; pb++) {
+			vertex.IDs1[pb] = 0.0f;
+			vertex.IDs2[pb] = 0.0f;
+			vertex.IDs3[pb] = 0.0f;
+			vertex.Weights1[pb] = 0.0f;
+			vertex.Weights2[pb] = 0.0f;
+			vertex.Weights3[pb] = 0.0f;
+		}
+		vertices.push_back(vertex);
+	}
+
+	GatherVertexInfluences(mesh, vertices, maxInfluences, data.skinning);
+
+	// Process Bones
+	for (unsigned int i = 0; i < mesh->mNumBones; i++) {
+
+		Bone  newBone;
+		newBone.name = mesh->mBones[i]->mName;
+		newBone.offsetMatrix = AiToGlm(mesh->mBones[i]->mOffsetMatrix);
+		newBone.transformation = glm::mat4(1.0f);
+
+		for (unsigned int j = 0; j < mesh->mBones[i]->mNumWeights; j++) {
+			unsigned int VertexID = mesh->mBones[i]->mWeights[j].mVertexId;
+			float Weight = mesh->mBones[i]->mWeights[j].mWeight;
+			newBone.push(VertexID, Weight);
+		}
+
+		data.bones.push_back(newBone);
+	}
+
+	// now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+	indices.reserve(mesh->mNumFaces * 3);
+	for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+	{
+		const aiFace &face = mesh->mFaces[i];
+		// retrieve all indices of the face and store them in the indices vector
+		for (unsigned int j = 0; j < face.mNumIndices; j++)
+			indices.push_back(face.mIndices[j]);
+	}
+
+	// process materials
+	const aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
+	// we assume a convention for sampler names in the shaders. Each diffuse texture should be named
+	// as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER.
+	// Same applies to other texture as the following list summarizes:
+	// diffuse: texture_diffuseN
+	// specular: texture_specularN
+	// normal: texture_normalN
+
+	// 1. diffuse maps
+	CollectMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", data.textures);
+	// 2. specular maps
+	CollectMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", data.textures);
+	// 3. normal maps
+	CollectMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", data.textures);
+	// 4. height maps
+	CollectMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", data.textures);
+}
+
+// Copies the node hierarchy (depth first) and every animation of the scene into a Skeleton
+inline void ImportSkeleton(const aiScene *scene, Skeleton &skeleton)
+{
+	skeleton.nodes.clear();
+	skeleton.clips.clear();
+	if (scene == nullptr || scene->mRootNode == nullptr) return;
+
+	vector<pair<const aiNode*, int> > stack(1, make_pair((const aiNode*)scene->mRootNode, -1));
+	while (!stack.empty()) {
+		const aiNode *node = stack.back().first;
+		SkeletonNode entry;
+		entry.name = node->mName.C_Str();
+		entry.parent = stack.back().second;
+		stack.pop_back();
+
+		int index = (int)skeleton.nodes.size();
+		skeleton.nodes.push_back(entry);
+		// pushed in reverse so the first child is visited first
+		for (unsigned int i = node->mNumChildren; i > 0; i--)
+			stack.push_back(make_pair((const aiNode*)node->mChildren[i - 1], index));
+	}
+
+	for (unsigned int a = 0; a < scene->mNumAnimations; a++) {
+		const aiAnimation *animation = scene->mAnimations[a];
+		skeleton.clips.push_back(AnimationClip());
+		AnimationClip &clip = skeleton.clips.back();
+		clip.name = animation->mName.C_Str();
+		clip.duration = (float)animation->mDuration;
+		clip.ticksPerSecond = (float)animation->mTicksPerSecond;
+		clip.nodeChannels.assign(skeleton.nodes.size(), -1);
+
+		for (unsigned int c = 0; c < animation->mNumChannels; c++) {
+			const aiNodeAnim *nodeAnim = animation->mChannels[c];
+			AnimationChannel channel;
+			for (unsigned int k = 0; k < nodeAnim->mNumPositionKeys; k++) {
+				const aiVectorKey &key = nodeAnim->mPositionKeys[k];
+				VectorKey converted = { (float)key.mTime, glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z) };
+				channel.positions.push_back(converted);
+			}
+			for (unsigned int k = 0; k < nodeAnim->mNumRotationKeys; k++) {
+				const aiQuatKey &key = nodeAnim->mRotationKeys[k];
+				QuatKey converted = { (float)key.mTime, glm::quat(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z) };
+				channel.rotations.push_back(converted);
+			}
+			for (unsigned int k = 0; k < nodeAnim->mNumScalingKeys; k++) {
+				const aiVectorKey &key = nodeAnim->mScalingKeys[k];
+				VectorKey converted = { (float)key.mTime, glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z) };
+				channel.scalings.push_back(converted);
+			}
+			clip.channels.push_back(channel);
+		}
+
+		// a node uses the first channel with its name
+		for (unsigned int n = 0; n < skeleton.nodes.size(); n++)
+			for (unsigned int c = 0; c < animation->mNumChannels; c++)
+				if (skeleton.nodes[n].name == animation->mChannels[c]->mNodeName.C_Str()) {
+					clip.nodeChannels[n] = (int)c;
+					break;
+				}
+	}
+}
+
+// What Model and AnimatedModel have in common: the meshes, textures and bones of a file, and the
+// pipeline that fills them. A file is converted by ConvertMesh and the import options (weld,
+// optimize, meshlets, levels of detail) or read back from its mesh cache, and its GL objects are
+// created at once or, with deferUpload, by the Upload() of the model on the context thread.
+class ImportedModel
+{
+public:
+	/*  Model Data */
+	vector<Texture> textures_loaded; // stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+	vector<Mesh>    meshes;
+	string          directory;
+	bool            gammaCorrection;
+
+	string          filename;
+
+	/* Bones data */
+	vector<Bone>    bones;
+
+	/* Skeleton and animations, copied out of the Assimp scene so it can be freed after the import.
+	   Empty when a Model comes from the baked cache. */
+	Skeleton        skeleton;
+
+	map<string, unsigned int> m_BoneMapping; // maps a bone name to its index
+	unsigned int              m_NumBones;
+	vector<BoneInfo>          m_BoneInfo;
+	glm::mat4                 m_GlobalInverseTransform;
+
+	// bone influences dropped during the last import
+	SkinningStats skinningStats;
+
+	/* Import options */
+	ModelLoadOptions options;
+
+	ImportedModel(const ModelLoadOptions &options, bool gamma)
+		: gammaCorrection(gamma), m_NumBones(0), options(options), uploaded(false)
+	{
+	}
+
+	// deletes the buffers of the meshes and gives the textures back to the TextureCache, which
+	// deletes the ones no other model uses
+	~ImportedModel()
+	{
+		for (unsigned int i = 0; i < meshes.size(); i++)
+			meshes[i].ReleaseBuffers();
+		for (unsigned int i = 0; i < textures_loaded.size(); i++)
+			TextureCache::Get().Release(textures_loaded[i].id);
+	}
+
+	// a copy would release the same buffers and textures twice
+	ImportedModel(const ImportedModel&) = delete;
+	ImportedModel& operator=(const ImportedModel&) = delete;
+
+	bool IsUploaded() const { return uploaded; }
+
+	// CPU and GPU bytes of the geometry of the meshes
+	GeometryMemory Memory() const
+	{
+		GeometryMemory memory;
+		for (unsigned int i = 0; i < meshes.size(); i++)
+			memory.Add(meshes[i].Memory());
+		return memory;
+	}
+
+protected:
+	/* Deferred upload data */
+	bool                                      uploaded;
+	vector<pair<unsigned int, TextureImage> > pendingTextures; // index in textures_loaded, decoded image
+	unique_ptr<MeshCache>                     pendingCache;    // cache kept mapped until Upload()
+
+	// writes what the import produced to the mesh cache of 'path'
+	void writeCache(string const &path)
+	{
+		LoadTimer timer(path, "model", "cache write");
+		MeshCache::Write(path, meshes, bones, m_GlobalInverseTransform, options.vertexFormat, CacheFlags(), options.weldVertices ? options.weldEpsilon : 0.0f);
+	}
+
+	// converts every mesh below the node and creates the Mesh objects, keeping the node order of the meshes.
+	void processNode(aiNode *node, const aiScene *scene)
+	{
+		vector<const aiMesh*> sceneMeshes;
+		CollectNodeMeshes(node, scene, sceneMeshes);
+
+		// vertex conversion, bone gathering and index flattening; every mesh goes into its own
+		// preallocated slot, so the result does not depend on how the work was scheduled
+		vector<MeshData> converted(sceneMeshes.size());
+		{
+			LoadTimer timer(filename, "model", "convert");
+			ParallelFor((unsigned int)sceneMeshes.size(), [&](unsigned int i) {
+				ConvertMesh(sceneMeshes[i], scene, converted[i], options.maxInfluences);
+			}, options.parallelMeshes ? 0 : 1);
+		}
+
+		// identical vertices merged, compared as they will be packed
+		if (options.weldVertices) {
+			{
+				LoadTimer timer(filename, "model", "weld");
+				ParallelFor((unsigned int)converted.size(), [&](unsigned int i) {
+					MeshData &data = converted[i];
+					VertexLayout layout = VertexLayout::For(options.vertexFormat, data.vertices.data(), (unsigned int)data.vertices.size());
+					data.welding = WeldVertices(data.vertices, data.indices, layout, options.weldEpsilon);
+				}, options.parallelMeshes ? 0 : 1);
+			}
+			MeshWeldStats welding;
+			for (unsigned int i = 0; i < converted.size(); i++)
+				welding.Add(converted[i].welding);
+			welding.Print(filename);
+		}
+
+		// vertex cache, overdraw and vertex fetch order, baked into the cache with the rest
+		if (options.optimizeMeshes) {
+			{
+				LoadTimer timer(filename, "model", "optimize");
+				ParallelFor((unsigned int)converted.size(), [&](unsigned int i) {
+					converted[i].optimization = OptimizeMesh(converted[i].vertices, converted[i].indices);
+				}, options.parallelMeshes ? 0 : 1);
+			}
+			for (unsigned int i = 0; i < converted.size(); i++)
+				PrintMeshOptimization(filename + " #" + to_string(i), converted[i].optimization);
+		}
+
+		// full meshes split into clusters for culling, before the levels are appended to them
+		if (options.buildMeshlets) {
+			{
+				LoadTimer timer(filename, "model", "meshlets");
+				ParallelFor((unsigned int)converted.size(), [&](unsigned int i) {
+					BuildMeshlets(converted[i].vertices, converted[i].indices, (unsigned int)converted[i].indices.size(), converted[i].meshlets);
+				}, options.parallelMeshes ? 0 : 1);
+			}
+			vector<vector<Meshlet> > meshlets;
+			for (unsigned int i = 0; i < converted.size(); i++)
+				meshlets.push_back(converted[i].meshlets);
+			PrintMeshlets(filename, meshlets);
+		}
+
+		// simplified levels appended to the indices of every mesh
+		if (options.lodLevels > 0) {
+			{
+				LoadTimer timer(filename, "model", "lods");
+				ParallelFor((unsigned int)converted.size(), [&](unsigned int i) {
+					BuildLodChain(converted[i].vertices, converted[i].indices, options.lodLevels, converted[i].lods);
+				}, options.parallelMeshes ? 0 : 1);
+			}
+			vector<vector<MeshLod> > lods;
+			for (unsigned int i = 0; i < converted.size(); i++)
+				lods.push_back(converted[i].lods);
+			PrintLodChain(filename, lods);
+		}
+
+		// textures and GL buffers, serially
+		meshes.reserve(meshes.size() + converted.size());
+		for (unsigned int i = 0; i < converted.size(); i++)
+		{
+			vector<Texture> textures;
+			{
+				LoadTimer timer(filename, "model", "textures");
+				for (unsigned int t = 0; t < converted[i].textures.size(); t++)
+					textures.push_back(loadTexture(converted[i].textures[t].path.c_str(), converted[i].textures[t].type));
+			}
+			// the converted arrays are handed over, not copied
+			LoadTimer timer(filename, "model", "buffers");
+			meshes.push_back(Mesh(std::move(converted[i].vertices), std::move(converted[i].indices), std::move(textures), !options.deferUpload, options.vertexFormat,
+				std::move(converted[i].lods), std::move(converted[i].meshlets)));
+			LoadProfiler::Get().AddGeometry(filename, meshes.back().vertexCount, meshes.back().indexCount, meshes.back().VertexBytes());
+		}
+
+		// as before, the bones are the ones of the last mesh
+		if (!converted.empty()) {
+			bones = std::move(converted.back().bones);
+			m_NumBones = converted.back().numBones;
+		}
+
+		skinningStats = SkinningStats();
+		for (unsigned int i = 0; i < converted.size(); i++)
+			skinningStats.Add(converted[i].skinning);
+		skinningStats.Print(filename);
+	}
+
+	// returns the texture with the given path relative to the model directory, loading it only the first time.
+	Texture loadTexture(const char *path, const string &typeName)
+	{
+		// check if texture was loaded before and if so, reuse it: skip loading a new texture
+		// (other models share it through the TextureCache, this list only holds this model's references)
+		for(unsigned int j = 0; j < textures_loaded.size(); j++)
+		{
+			if(std::strcmp(textures_loaded[j].path.data(), path) == 0)
+			{
+				return textures_loaded[j]; // a texture with the same filepath has already been loaded (optimization)
+			}
+		}
+		// if texture hasn't been loaded already, load it
+		Texture texture;
+		texture.type = typeName;
+		texture.path = path;
+		string filename = JoinPath(this->directory, path);
+		if (options.deferUpload)
+		{   // decode it now (unless it is streamed later), the GL texture is created by Upload()
+			texture.id = 0;
+			TextureImage image;
+			if (options.streamer)
+				image.path = filename;
+			else
+				image = TextureCache::Get().Decode(filename);
+			pendingTextures.push_back(make_pair((unsigned int)textures_loaded.size(), std::move(image)));
+		}
+		else if (options.streamer)
+			texture.id = options.streamer->Request(filename, typeName == "texture_normal");
+		else
+			texture.id = TextureCache::Get().Acquire(filename);
+		textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+		return texture;
+	}
+
+	// MESH_CACHE_* bits of what the import does to the meshes with these options
+	uint32_t CacheFlags() const
+	{
+		return (options.weldVertices ? MESH_CACHE_WELDED : 0) | (options.optimizeMeshes ? MESH_CACHE_OPTIMIZED : 0) | (options.lodLevels > 0 ? MESH_CACHE_LODS : 0)
+			| (options.buildMeshlets ? MESH_CACHE_MESHLETS : 0) | MeshCacheInfluenceFlags(options.maxInfluences) | MeshCacheLodFlags(options.lodLevels);
+	}
+
+	// builds the meshes straight from the baked cache of the model, false if there is no usable cache
+	bool loadFromCache(string const &path)
+	{
+		unique_ptr<MeshCache> cache(new MeshCache());
+		{
+			LoadTimer timer(path, "model", "cache read");
+			if (!cache->Open(path)) return false;
+		}
+		// baked with another vertex format, or without the processing asked for: import again,
+		// which rewrites the cache
+		if (cache->vertexFormat != options.vertexFormat) return false;
+		if ((cache->flags & CacheFlags()) != CacheFlags()) return false;
+		if (MeshCacheInfluences(cache->flags) != options.maxInfluences) return false;
+		if (MeshCacheLods(cache->flags) != options.lodLevels) return false;
+		// welded or not, and with which tolerance, changes the vertices themselves: exact match
+		if ((cache->flags & MESH_CACHE_WELDED) != (CacheFlags() & MESH_CACHE_WELDED)) return false;
+		if (options.weldVertices && cache->weldEpsilon != options.weldEpsilon) return false;
+		LoadProfiler::Get().AddBytesRead(path, "model", FileSizeOnDisk(MeshCache::CachePath(path)));
+
+		m_GlobalInverseTransform = cache->globalInverseTransform;
+		bones = cache->bones;
+		m_NumBones = (unsigned int)bones.size();
+
+		// textures are requested up front so a deferred load decodes them on this thread
+		LoadTimer timer(path, "model", "textures");
+		for (unsigned int i = 0; i < cache->meshes.size(); i++) {
+			const BakedMesh &baked = cache->meshes[i];
+			for (unsigned int t = 0; t < baked.textures.size(); t++)
+				loadTexture(baked.textures[t].path.c_str(), baked.textures[t].type);
+		}
+
+		timer.Stop();
+
+		if (options.deferUpload)
+			pendingCache = std::move(cache);
+		else
+			buildFromCache(*cache);
+		return true;
+	}
+
+	void buildFromCache(const MeshCache &cache)
+	{
+		meshes.reserve(cache.meshes.size());
+		for (unsigned int i = 0; i < cache.meshes.size(); i++) {
+			const BakedMesh &baked = cache.meshes[i];
+			vector<Texture> textures;
+			for (unsigned int t = 0; t < baked.textures.size(); t++)
+				textures.push_back(loadTexture(baked.textures[t].path.c_str(), baked.textures[t].type));
+			LoadTimer timer(filename, "model", "buffers");
+			meshes.push_back(Mesh(baked.vertices, baked.vertexCount, baked.layout, baked.indices, baked.indexCount, std::move(textures), baked.boundsMin, baked.boundsMax, baked.lods, baked.meshlets));
+			// no CPU vertices to trim, but collision wants its copy out of the mapping
+			if (options.cpuData == MESH_CPU_COLLISION)
+				meshes.back().SetCollisionData(baked.vertices + baked.layout.StreamOffset(STREAM_POSITION, baked.vertexCount), baked.indices);
+			LoadProfiler::Get().AddGeometry(filename, baked.vertexCount, baked.indexCount, meshes.back().VertexBytes());
+		}
+	}
+
+	// drops the CPU copies the cpuData policy does not keep, once nothing needs them: the cache
+	// has been written and the buffers (or a merged geometry) hold the vertices
+	void releaseCpuData()
+	{
+		if (options.cpuData == MESH_CPU_KEEP) return;
+		for (unsigned int i = 0; i < meshes.size(); i++)
+			meshes[i].ReleaseCpuData(options.cpuData);
+	}
+
+	// GL side of a deferred load: textures first, then the mesh buffers
+	void finishUpload()
+	{
+		LoadTimer timer(filename, "model", "textures");
+		for (unsigned int i = 0; i < pendingTextures.size(); i++) {
+			Texture &texture = textures_loaded[pendingTextures[i].first];
+			if (options.streamer)
+				texture.id = options.streamer->Request(pendingTextures[i].second.path, texture.type == "texture_normal");
+			else
+				texture.id = TextureCache::Get().Acquire(pendingTextures[i].second);
+		}
+		pendingTextures.clear();
+		timer.Stop();
+
+		if (pendingCache) {
+			buildFromCache(*pendingCache);
+			pendingCache.reset();
+			return;
+		}
+
+		for (unsigned int i = 0; i < meshes.size(); i++) {
+			// the meshes got copies of the textures before they had an id
+			for (unsigned int t = 0; t < meshes[i].textures.size(); t++)
+				meshes[i].textures[t].id = loadTexture(meshes[i].textures[t].path.c_str(), meshes[i].textures[t].type).id;
+			LoadTimer bufferTimer(filename, "model", "buffers");
+			meshes[i].Upload();
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,308 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <vertexlayout.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdint.h>
+using namespace std;
+
+// Meshlets
+// --------
+// The first LOD of a mesh is split into small clusters of neighbouring triangles whose indices
+// are stored one after the other, so a cluster is a range of the element buffer. Each one keeps a
+// bounding sphere, for frustum culling, and a normal cone (Barczak, "Triangle Cone Culling"; apex
+// form as in meshoptimizer): when the camera sees every triangle of the cluster from behind, the
+// whole range is skipped. The ranges that survive go to the GPU with one glMultiDrawElements.
+
+#define MESHLET_MAX_VERTICES  64
+#define MESHLET_MAX_TRIANGLES 124
+
+// in object space, stored as is in the mesh cache
+struct Meshlet
+{
+	unsigned int indexOffset;
+	unsigned int triangleCount;
+	glm::vec3    center;
+	float        radius;
+	glm::vec3    coneApex;
+	glm::vec3    coneAxis;
+	float        coneCutoff; // > 1 when the triangles face too many ways for the cone to cull
+};
+
+// Reorders the first 'indexCount' indices into meshlets, grown from the triangle order they come
+// in (the cache-optimized one, if any) by adding the neighbour that brings the fewest new vertices
+// and then the one closest to the cluster normal.
+inline void BuildMeshlets(const vector<Vertex> &vertices, vector<unsigned int> &indices, unsigned int indexCount, vector<Meshlet> &meshlets)
+{
+	meshlets.clear();
+	const unsigned int vertexCount = (unsigned int)vertices.size();
+	const unsigned int triangleCount = indexCount / 3;
+	if (triangleCount == 0) return;
+
+	vector<glm::vec3> normals(triangleCount);
+	for (unsigned int t = 0; t < triangleCount; t++) {
+		const glm::vec3 &p0 = vertices[indices[t * 3]].Position;
+		glm::vec3 n = glm::cross(vertices[indices[t * 3 + 1]].Position - p0, vertices[indices[t * 3 + 2]].Position - p0);
+		float length = glm::length(n);
+		normals[t] = length > 0.0f ? n / length : glm::vec3(0.0f);
+	}
+
+	// triangles of every vertex
+	vector<unsigned int> firstTriangle(vertexCount + 1, 0);
+	for (unsigned int i = 0; i < triangleCount * 3; i++)
+		firstTriangle[indices[i] + 1]++;
+	for (unsigned int v = 0; v < vertexCount; v++)
+		firstTriangle[v + 1] += firstTriangle[v];
+	vector<unsigned int> adjacency(triangleCount * 3);
+	{
+		vector<unsigned int> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+		for (unsigned int t = 0; t < triangleCount; t++)
+			for (unsigned int k = 0; k < 3; k++)
+				adjacency[filled[indices[t * 3 + k]]++] = t;
+	}
+
+	vector<bool> emitted(triangleCount, false);
+	vector<unsigned int> inMeshlet(vertexCount, 0); // meshlet number + 1 of the last one using the vertex
+	vector<unsigned int> output;
+	output.reserve(triangleCount * 3);
+	vector<unsigned int> triangles, verts;
+
+	for (unsigned int seed = 0; seed < triangleCount; seed++) {
+		if (emitted[seed]) continue;
+		const unsigned int stamp = (unsigned int)meshlets.size() + 1;
+		triangles.clear();
+		verts.clear();
+		glm::vec3 normalSum(0.0f);
+
+		unsigned int next = seed;
+		while (true) {
+			emitted[next] = true;
+			triangles.push_back(next);
+			normalSum += normals[next];
+			for (unsigned int k = 0; k < 3; k++) {
+				unsigned int v = indices[next * 3 + k];
+				if (inMeshlet[v] != stamp) {
+					inMeshlet[v] = stamp;
+					verts.push_back(v);
+				}
+			}
+			if (triangles.size() >= MESHLET_MAX_TRIANGLES) break;
+
+			// best neighbour still fitting in the limits
+			float axisLength = glm::length(normalSum);
+			glm::vec3 axis = axisLength > 0.0f ? normalSum / axisLength : glm::vec3(0.0f);
+			int best = -1;
+			unsigned int bestNew = 4;
+			float bestDot = -2.0f;
+			for (unsigned int i = 0; i < verts.size(); i++) {
+				unsigned int v = verts[i];
+				for (unsigned int j = firstTriangle[v]; j < firstTriangle[v + 1]; j++) {
+					unsigned int t = adjacency[j];
+					if (emitted[t]) continue;
+					unsigned int added = 0;
+					for (unsigned int k = 0; k < 3; k++)
+						if (inMeshlet[indices[t * 3 + k]] != stamp) added++;
+					if (verts.size() + added > MESHLET_MAX_VERTICES) continue;
+					float d = glm::dot(normals[t], axis);
+					if (added < bestNew || (added == bestNew && d > bestDot)) {
+						best = (int)t;
+						bestNew = added;
+						bestDot = d;
+					}
+				}
+			}
+			if (best < 0) break;
+			next = (unsigned int)best;
+		}
+
+		Meshlet meshlet;
+		meshlet.indexOffset = (unsigned int)output.size();
+		meshlet.triangleCount = (unsigned int)triangles.size();
+		for (unsigned int i = 0; i < triangles.size(); i++)
+			for (unsigned int k = 0; k < 3; k++)
+				output.push_back(indices[triangles[i] * 3 + k]);
+
+		// bounding sphere around the box of its vertices
+		glm::vec3 boxMin = vertices[verts[0]].Position, boxMax = boxMin;
+		for (unsigned int i = 1; i < verts.size(); i++) {
+			boxMin = glm::min(boxMin, vertices[verts[i]].Position);
+			boxMax = glm::max(boxMax, vertices[verts[i]].Position);
+		}
+		meshlet.center = (boxMin + boxMax) * 0.5f;
+		meshlet.radius = 0.0f;
+		for (unsigned int i = 0; i < verts.size(); i++)
+			meshlet.radius = max(meshlet.radius, glm::length(vertices[verts[i]].Position - meshlet.center));
+
+		// normal cone: the axis is the mean normal, the cutoff comes from the normal furthest from
+		// it and the apex is the point of the axis behind every triangle plane
+		float axisLength = glm::length(normalSum);
+		meshlet.coneAxis = axisLength > 0.0f ? normalSum / axisLength : glm::vec3(0.0f, 0.0f, 1.0f);
+		meshlet.coneApex = meshlet.center;
+		meshlet.coneCutoff = 2.0f;
+		float minDot = 1.0f;
+		bool anyTriangle = false;
+		for (unsigned int i = 0; i < triangles.size(); i++) {
+			if (normals[triangles[i]] == glm::vec3(0.0f)) continue;
+			minDot = min(minDot, glm::dot(normals[triangles[i]], meshlet.coneAxis));
+			anyTriangle = true;
+		}
+		if (anyTriangle && axisLength > 0.0f && minDot > 0.0f) {
+			float maxT = 0.0f;
+			for (unsigned int i = 0; i < triangles.size(); i++) {
+				const glm::vec3 &n = normals[triangles[i]];
+				if (n == glm::vec3(0.0f)) continue;
+				float dc = glm::dot(vertices[indices[triangles[i] * 3]].Position - meshlet.center, n);
+				float dn = glm::dot(meshlet.coneAxis, n);
+				maxT = max(maxT, -dc / dn);
+			}
+			meshlet.coneApex = meshlet.center - meshlet.coneAxis * maxT;
+			meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+		}
+		meshlets.push_back(meshlet);
+	}
+
+	copy(output.begin(), output.end(), indices.begin());
+}
+
+// one line per model
+inline void PrintMeshlets(const string &name, const vector<vector<Meshlet> > &meshMeshlets)
+{
+	unsigned long long count = 0, triangles = 0, cones = 0;
+	for (size_t m = 0; m < meshMeshlets.size(); m++) {
+		for (size_t i = 0; i < meshMeshlets[m].size(); i++) {
+			count++;
+			triangles += meshMeshlets[m][i].triangleCount;
+			if (meshMeshlets[m][i].coneCutoff <= 1.0f) cones++;
+		}
+	}
+	if (count == 0) return;
+	cout << "Meshlets: " << name << ": " << count << " meshlets, " << (float)triangles / (float)count
+		<< " triangles each, " << cones << " with a usable normal cone" << endl;
+}
+
+// What the culling did, summed over the frame
+struct MeshletCullStats
+{
+	unsigned long long meshesCulled;  // whole meshes outside the frustum
+	unsigned long long tested;
+	unsigned long long frustumCulled;
+	unsigned long long backfaceCulled;
+	unsigned long long drawn;
+	unsigned long long draws; // ranges submitted, after merging the neighbouring ones
+
+	MeshletCullStats() : meshesCulled(0), tested(0), frustumCulled(0), backfaceCulled(0), drawn(0), draws(0) {}
+
+	void Print() const {
+		cout << "Meshlets: " << meshesCulled << " meshes and " << frustumCulled << " of " << tested << " meshlets outside the frustum, "
+			<< backfaceCulled << " back-facing, " << drawn << " drawn in " << draws << " ranges" << endl;
+	}
+};
+
+// Camera the meshlets are culled for, built once per frame. It also keeps the draw lists, so
+// the frames do not allocate them again.
+struct CullView
+{
+	glm::mat4 viewProjection;
+	glm::vec3 cameraPosition;
+	bool      backfaceCulling; // cone culling: only for closed or one-sided geometry
+
+	mutable MeshletCullStats      stats;
+	mutable vector<GLsizei>       counts;
+	mutable vector<const void*>   offsets;
+
+	CullView() : viewProjection(1.0f), cameraPosition(0.0f), backfaceCulling(true) {}
+
+	CullView(const glm::mat4 &viewProjection, const glm::vec3 &cameraPosition, bool backfaceCulling = true)
+		: viewProjection(viewProjection), cameraPosition(cameraPosition), backfaceCulling(backfaceCulling) {}
+};
+
+// The CullView moved into the object space of one model (frustum planes of viewProjection * model
+// and the camera through the inverse model matrix), so the meshlet data is used untransformed.
+// The cone test assumes a uniform scale.
+class MeshletCuller
+{
+public:
+	MeshletCuller(const CullView &view, const glm::mat4 &model) : view(view) {
+		glm::mat4 m = view.viewProjection * model;
+		for (unsigned int i = 0; i < 3; i++) {
+			planes[i * 2] = row(m, 3) + row(m, i);
+			planes[i * 2 + 1] = row(m, 3) - row(m, i);
+		}
+		for (unsigned int i = 0; i < 6; i++)
+			planes[i] /= glm::length(glm::vec3(planes[i]));
+		camera = glm::vec3(glm::inverse(model) * glm::vec4(view.cameraPosition, 1.0f));
+	}
+
+	// false when the sphere is completely outside the frustum
+	bool SphereVisible(const glm::vec3 &center, float radius) const {
+		for (unsigned int i = 0; i < 6; i++)
+			if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+				return false;
+		return true;
+	}
+
+	// Fills the CullView draw lists with the index ranges of the visible meshlets, merging the
+	// ranges that follow each other. Returns how many there are, see Counts() and Offsets().
+	GLsizei Collect(const vector<Meshlet> &meshlets, size_t indexSize) const {
+		view.counts.clear();
+		view.offsets.clear();
+		unsigned int rangeStart = 0, rangeEnd = 0; // in indices, empty range when equal
+		for (unsigned int i = 0; i < meshlets.size(); i++) {
+			const Meshlet &meshlet = meshlets[i];
+			view.stats.tested++;
+			if (!SphereVisible(meshlet.center, meshlet.radius)) {
+				view.stats.frustumCulled++;
+				continue;
+			}
+			if (view.backfaceCulling && meshlet.coneCutoff <= 1.0f &&
+				glm::dot(glm::normalize(meshlet.coneApex - camera), meshlet.coneAxis) >= meshlet.coneCutoff) {
+				view.stats.backfaceCulled++;
+				continue;
+			}
+			view.stats.drawn++;
+			if (rangeEnd != rangeStart && meshlet.indexOffset == rangeEnd) {
+				rangeEnd += meshlet.triangleCount * 3;
+				continue;
+			}
+			flush(rangeStart, rangeEnd, indexSize);
+			rangeStart = meshlet.indexOffset;
+			rangeEnd = rangeStart + meshlet.triangleCount * 3;
+		}
+		flush(rangeStart, rangeEnd, indexSize);
+		view.stats.draws += view.counts.size();
+		return (GLsizei)view.counts.size();
+	}
+
+	// arguments of glMultiDrawElements for the last Collect()
+	const GLsizei* Counts() const { return view.counts.data(); }
+	const void* const* Offsets() const { return view.offsets.data(); }
+
+	// counts a mesh skipped as a whole
+	void MeshCulled() const { view.stats.meshesCulled++; }
+
+private:
+	const CullView &view;
+	glm::vec4       planes[6]; // left, right, bottom, top, near, far; normals inwards
+	glm::vec3       camera;
+
+	static glm::vec4 row(const glm::mat4 &m, unsigned int i) {
+		return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+	}
+
+	void flush(unsigned int start, unsigned int end, size_t indexSize) const {
+		if (end == start) return;
+		view.counts.push_back((GLsizei)(end - start));
+		view.offsets.push_back((const void*)(uintptr_t)(start * indexSize));
+	}
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef MESHLOD_H
+#define MESHLOD_H
+
+#include <glm/glm.hpp>
+
+#include <mesh.h>
+
+#include <algorithm>
+#include <vector>
+#include <math.h>
+using namespace std;
+
+// Level of detail selection
+// -------------------------
+// Every LOD of a mesh knows how far its surface can be from the full one (MeshLod::error, in
+// object units). Projected on the screen that distance becomes a number of pixels, and the mesh
+// is drawn with the coarsest level that stays under 'pixelError'. To keep a mesh standing at the
+// limit from switching every frame, a coarser level has to be clearly under the limit before it
+// is taken (by 'hysteresis') and the current one clearly over it before going back.
+
+// Camera the levels are picked for, built once per frame
+struct LodView
+{
+	glm::vec3 cameraPosition;
+	float     pixelsPerUnit; // pixels covered by one unit seen at distance one
+	float     pixelError;    // largest error allowed on screen, in pixels
+	float     hysteresis;    // fraction of pixelError
+
+	LodView() : cameraPosition(0.0f), pixelsPerUnit(0.0f), pixelError(1.0f), hysteresis(0.25f) {}
+
+	// 'fovY' in radians, 'viewportHeight' in pixels
+	LodView(const glm::vec3 &cameraPosition, float fovY, float viewportHeight, float pixelError = 1.0f, float hysteresis = 0.25f)
+		: cameraPosition(cameraPosition), pixelsPerUnit(viewportHeight / (2.0f * tanf(fovY * 0.5f))), pixelError(pixelError), hysteresis(hysteresis) {}
+
+	// pixels per object unit of error for a mesh drawn with 'model', measured at the nearest
+	// point of its bounding sphere (negative when the camera is inside it)
+	float ErrorScale(const Mesh &mesh, const glm::mat4 &model) const {
+		glm::vec3 center = glm::vec3(model * glm::vec4((mesh.boundsMin + mesh.boundsMax) * 0.5f, 1.0f));
+		float scale = max(glm::length(glm::vec3(model[0])), max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		float radius = glm::length(mesh.boundsMax - mesh.boundsMin) * 0.5f * scale;
+		float distance = glm::length(center - cameraPosition) - radius;
+		if (distance <= 0.0f) return -1.0f;
+		return scale * pixelsPerUnit / distance;
+	}
+
+	// level to draw 'mesh' with, given the one it was drawn with last
+	unsigned int Select(const Mesh &mesh, const glm::mat4 &model, unsigned int current) const {
+		const vector<MeshLod> &lods = mesh.lods;
+		if (lods.size() <= 1) return 0;
+		float errorScale = ErrorScale(mesh, model);
+		if (errorScale < 0.0f) return 0;
+		current = min(current, (unsigned int)lods.size() - 1);
+
+		// too coarse now: the coarsest level under the limit
+		if (lods[current].error * errorScale > pixelError * (1.0f + hysteresis)) {
+			while (current > 0 && lods[current].error * errorScale > pixelError)
+				current--;
+			return current;
+		}
+		// a coarser one clearly under it
+		unsigned int next = current;
+		while (next + 1 < lods.size() && lods[next + 1].error * errorScale <= pixelError * (1.0f - hysteresis))
+			next++;
+		return next;
+	}
+
+	// Select for every mesh, 'levels' keeps the choice between frames
+	void SelectAll(const vector<Mesh> &meshes, const glm::mat4 &model, vector<unsigned int> &levels) const {
+		levels.resize(meshes.size(), 0);
+		for (unsigned int i = 0; i < meshes.size(); i++)
+			levels[i] = Select(meshes[i], model, levels[i]);
+	}
+};
+
+#endif
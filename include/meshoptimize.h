@@ -0,0 +1,343 @@
+#ifndef MESHOPTIMIZE_H
+#define MESHOPTIMIZE_H
+
+#include <glm/glm.hpp>
+
+#include <vertexlayout.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <math.h>
+using namespace std;
+
+// Mesh optimization
+// -----------------
+// Reorders the triangles and vertices of a mesh for the GPU, without changing what is drawn:
+//   1. triangles for post-transform vertex cache reuse (Forsyth's linear-speed algorithm)
+//   2. clusters of those triangles so the outward-facing ones come first, which cuts overdraw
+//      from most viewpoints (as in Tipsify's cluster sorting)
+//   3. vertices into first-use order, so the vertex fetch walks memory forward
+// It runs once on import and the result is baked into the mesh cache.
+
+// vertices the cache simulation of the report holds (FIFO, like most hardware)
+#define VERTEX_CACHE_REPORT_SIZE 16
+// LRU cache size the triangle order is optimized for
+#define VERTEX_CACHE_OPTIMIZE_SIZE 32
+
+// Post-transform cache efficiency of an index list: ACMR is vertex shader runs per triangle
+// (0.5 at best for regular grids, 3 at worst), ATVR runs per unique vertex (1 is ideal).
+struct VertexCacheStats
+{
+	float acmr;
+	float atvr;
+
+	VertexCacheStats() : acmr(0.0f), atvr(0.0f) {}
+};
+
+struct MeshOptimizationStats
+{
+	VertexCacheStats before;
+	VertexCacheStats after;
+	unsigned int     triangles;
+	unsigned int     vertices;
+	unsigned int     clusters; // after the overdraw pass
+
+	MeshOptimizationStats() : triangles(0), vertices(0), clusters(0) {}
+};
+
+// simulates a FIFO post-transform cache over the index list
+inline VertexCacheStats AnalyzeVertexCache(const vector<unsigned int> &indices, unsigned int vertexCount, unsigned int cacheSize = VERTEX_CACHE_REPORT_SIZE)
+{
+	VertexCacheStats stats;
+	if (indices.size() < 3 || vertexCount == 0) return stats;
+
+	// timestamp of the vertex when it entered the cache: it is still in it while fewer than
+	// cacheSize misses happened since
+	vector<unsigned int> entered(vertexCount, 0);
+	vector<bool> seen(vertexCount, false);
+	unsigned int misses = 0, unique = 0;
+	for (size_t i = 0; i < indices.size(); i++) {
+		unsigned int v = indices[i];
+		if (!seen[v]) {
+			seen[v] = true;
+			unique++;
+		}
+		else if (misses - entered[v] < cacheSize)
+			continue;
+		entered[v] = misses;
+		misses++;
+	}
+
+	stats.acmr = (float)misses / (float)(indices.size() / 3);
+	stats.atvr = unique > 0 ? (float)misses / (float)unique : 0.0f;
+	return stats;
+}
+
+// Triangle order for vertex cache reuse (Tom Forsyth, "Linear-Speed Vertex Cache Optimisation").
+// Every vertex gets a score from its position in a simulated LRU cache and from how many
+// triangles still use it; the triangle with the best sum of scores goes next.
+inline void OptimizeVertexCache(vector<unsigned int> &indices, unsigned int vertexCount)
+{
+	const unsigned int triangleCount = (unsigned int)indices.size() / 3;
+	if (triangleCount == 0) return;
+
+	const int cacheSize = VERTEX_CACHE_OPTIMIZE_SIZE;
+	const float lastTriangleScore = 0.75f;
+	const float cacheDecayPower = 1.5f;
+	const float valenceBoostScale = 2.0f;
+	const float valenceBoostPower = 0.5f;
+
+	// triangles of every vertex
+	vector<unsigned int> valence(vertexCount, 0);
+	for (size_t i = 0; i < indices.size(); i++)
+		valence[indices[i]]++;
+	vector<unsigned int> firstTriangle(vertexCount + 1, 0);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		firstTriangle[v + 1] = firstTriangle[v] + valence[v];
+	vector<unsigned int> adjacency(indices.size());
+	vector<unsigned int> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+	for (unsigned int t = 0; t < triangleCount; t++)
+		for (unsigned int k = 0; k < 3; k++)
+			adjacency[filled[indices[t * 3 + k]]++] = t;
+
+	// 'remaining' counts the triangles not emitted yet; the first ones of each adjacency list are
+	// kept as the live triangles of the vertex
+	vector<unsigned int> remaining(valence);
+	vector<int> cachePosition(vertexCount, -1);
+
+	auto vertexScore = [&](unsigned int v) -> float {
+		if (remaining[v] == 0) return -1.0f;
+		float score = 0.0f;
+		int position = cachePosition[v];
+		if (position >= 0) {
+			if (position < 3)
+				score = lastTriangleScore;
+			else
+				score = powf(1.0f - (float)(position - 3) / (float)(cacheSize - 3), cacheDecayPower);
+		}
+		return score + valenceBoostScale * powf((float)remaining[v], -valenceBoostPower);
+	};
+
+	vector<float> vertexScores(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		vertexScores[v] = vertexScore(v);
+	vector<float> triangleScores(triangleCount);
+	for (unsigned int t = 0; t < triangleCount; t++)
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+
+	vector<bool> emitted(triangleCount, false);
+	vector<unsigned int> output;
+	output.reserve(indices.size());
+	vector<unsigned int> cache, nextCache;
+	cache.reserve(cacheSize + 3);
+	nextCache.reserve(cacheSize + 3);
+
+	unsigned int cursor = 0; // every triangle before it has been emitted
+	int best = -1;
+	for (unsigned int emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+		if (best < 0) {
+			// nothing in the cache to continue from (a new island): start from the first triangle
+			// left, scanning for the best one would make the pass quadratic
+			while (emitted[cursor]) cursor++;
+			best = (int)cursor;
+		}
+
+		unsigned int triangle = (unsigned int)best;
+		emitted[triangle] = true;
+		const unsigned int *corners = &indices[triangle * 3];
+		output.push_back(corners[0]);
+		output.push_back(corners[1]);
+		output.push_back(corners[2]);
+
+		// the corners go to the front of the cache, the rest keep their order
+		nextCache.assign(corners, corners + 3);
+		for (unsigned int i = 0; i < cache.size(); i++)
+			if (cache[i] != corners[0] && cache[i] != corners[1] && cache[i] != corners[2])
+				nextCache.push_back(cache[i]);
+		cache.swap(nextCache);
+
+		// drop the triangle from the live list of its vertices
+		for (unsigned int k = 0; k < 3; k++) {
+			unsigned int v = corners[k];
+			unsigned int *live = &adjacency[firstTriangle[v]];
+			for (unsigned int i = 0; i < remaining[v]; i++) {
+				if (live[i] == triangle) {
+					live[i] = live[remaining[v] - 1];
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+
+		// new scores for the vertices in the cache (and the ones that just fell out of it), and
+		// the best triangle around them for the next step
+		for (unsigned int i = 0; i < cache.size(); i++) {
+			unsigned int v = cache[i];
+			cachePosition[v] = i < (unsigned int)cacheSize ? (int)i : -1;
+		}
+		best = -1;
+		float bestScore = -1.0f;
+		for (unsigned int i = 0; i < cache.size(); i++) {
+			unsigned int v = cache[i];
+			float score = vertexScore(v);
+			float delta = score - vertexScores[v];
+			vertexScores[v] = score;
+			for (unsigned int j = 0; j < remaining[v]; j++) {
+				unsigned int t = adjacency[firstTriangle[v] + j];
+				triangleScores[t] += delta;
+				if (triangleScores[t] > bestScore) {
+					bestScore = triangleScores[t];
+					best = (int)t;
+				}
+			}
+		}
+		if (cache.size() > (size_t)cacheSize)
+			cache.resize(cacheSize);
+	}
+
+	indices.swap(output);
+}
+
+// Overdraw pass over a cache-optimized index list. The list is cut into clusters where the
+// vertex cache restarts anyway (a triangle missing all three corners) or, inside long runs,
+// where cutting costs little cache reuse ('threshold' is the ACMR the clusters may lose, 1.05 =
+// 5%). Clusters are then drawn facing-outward first: the ones whose normal points away from the
+// center of the mesh hide the others from most viewpoints.
+inline unsigned int OptimizeOverdraw(vector<unsigned int> &indices, const vector<Vertex> &vertices, float threshold = 1.05f)
+{
+	const unsigned int triangleCount = (unsigned int)indices.size() / 3;
+	if (triangleCount < 2) return triangleCount;
+
+	// misses per triangle with the report cache
+	vector<unsigned char> misses(triangleCount);
+	{
+		vector<unsigned int> entered(vertices.size(), 0);
+		vector<bool> seen(vertices.size(), false);
+		unsigned int total = 0;
+		for (unsigned int t = 0; t < triangleCount; t++) {
+			misses[t] = 0;
+			for (unsigned int k = 0; k < 3; k++) {
+				unsigned int v = indices[t * 3 + k];
+				if (seen[v] && total - entered[v] < VERTEX_CACHE_REPORT_SIZE) continue;
+				seen[v] = true;
+				entered[v] = total++;
+				misses[t]++;
+			}
+		}
+	}
+
+	// hard boundaries, then soft ones inside every hard cluster
+	vector<unsigned int> clusterStarts;
+	unsigned int hardStart = 0;
+	for (unsigned int t = 1; t <= triangleCount; t++) {
+		if (t < triangleCount && misses[t] < 3) continue;
+
+		unsigned int hardMisses = 0;
+		for (unsigned int i = hardStart; i < t; i++)
+			hardMisses += misses[i];
+		float hardACMR = (float)hardMisses / (float)(t - hardStart);
+
+		clusterStarts.push_back(hardStart);
+		unsigned int softMisses = 0, softStart = hardStart;
+		for (unsigned int i = hardStart; i + 1 < t; i++) {
+			softMisses += misses[i];
+			unsigned int count = i + 1 - softStart;
+			// the cluster so far reuses the cache about as well as the whole run: cut here
+			if (count >= 16 && (float)softMisses / (float)count <= hardACMR * threshold && t - (i + 1) >= 16) {
+				clusterStarts.push_back(i + 1);
+				softStart = i + 1;
+				softMisses = 0;
+			}
+		}
+		hardStart = t;
+	}
+	clusterStarts.push_back(triangleCount);
+	unsigned int clusterCount = (unsigned int)clusterStarts.size() - 1;
+
+	// area weighted centroid of the mesh and of every cluster, with the cluster normal
+	vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f));
+	vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+	vector<float> areas(clusterCount, 0.0f);
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for (unsigned int c = 0; c < clusterCount; c++) {
+		for (unsigned int t = clusterStarts[c]; t < clusterStarts[c + 1]; t++) {
+			const glm::vec3 &a = vertices[indices[t * 3]].Position;
+			const glm::vec3 &b = vertices[indices[t * 3 + 1]].Position;
+			const glm::vec3 &d = vertices[indices[t * 3 + 2]].Position;
+			glm::vec3 normal = glm::cross(b - a, d - a);
+			float area = glm::length(normal);
+			centroids[c] += (a + b + d) * (area / 3.0f);
+			normals[c] += normal;
+			areas[c] += area;
+		}
+		meshCentroid += centroids[c];
+		meshArea += areas[c];
+		if (areas[c] > 0.0f) centroids[c] /= areas[c];
+	}
+	if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+	vector<float> sortKeys(clusterCount);
+	vector<unsigned int> order(clusterCount);
+	for (unsigned int c = 0; c < clusterCount; c++) {
+		float length = glm::length(normals[c]);
+		glm::vec3 normal = length > 0.0f ? normals[c] / length : glm::vec3(0.0f);
+		sortKeys[c] = glm::dot(centroids[c] - meshCentroid, normal);
+		order[c] = c;
+	}
+	stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return sortKeys[a] > sortKeys[b]; });
+
+	vector<unsigned int> output;
+	output.reserve(indices.size());
+	for (unsigned int i = 0; i < clusterCount; i++) {
+		unsigned int c = order[i];
+		output.insert(output.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+	}
+	indices.swap(output);
+	return clusterCount;
+}
+
+// Renumbers the vertices in the order the index list first uses them and drops the unused ones
+inline void OptimizeVertexFetch(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+	const unsigned int unused = ~0u;
+	vector<unsigned int> remap(vertices.size(), unused);
+	vector<Vertex> reordered;
+	reordered.reserve(vertices.size());
+	for (size_t i = 0; i < indices.size(); i++) {
+		unsigned int &target = remap[indices[i]];
+		if (target == unused) {
+			target = (unsigned int)reordered.size();
+			reordered.push_back(vertices[indices[i]]);
+		}
+		indices[i] = target;
+	}
+	vertices.swap(reordered);
+}
+
+// the three passes, in order
+inline MeshOptimizationStats OptimizeMesh(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+	MeshOptimizationStats stats;
+	stats.triangles = (unsigned int)indices.size() / 3;
+	stats.before = AnalyzeVertexCache(indices, (unsigned int)vertices.size());
+
+	OptimizeVertexCache(indices, (unsigned int)vertices.size());
+	stats.clusters = OptimizeOverdraw(indices, vertices);
+	OptimizeVertexFetch(vertices, indices);
+
+	stats.vertices = (unsigned int)vertices.size();
+	stats.after = AnalyzeVertexCache(indices, (unsigned int)vertices.size());
+	return stats;
+}
+
+inline void PrintMeshOptimization(const string &name, const MeshOptimizationStats &stats)
+{
+	cout << "MeshOptimize: " << name << ": " << stats.triangles << " triangles, " << stats.vertices << " vertices, "
+		<< stats.clusters << " clusters, ACMR " << stats.before.acmr << " -> " << stats.after.acmr
+		<< ", ATVR " << stats.before.atvr << " -> " << stats.after.atvr << endl;
+}
+
+#endif
@@ -0,0 +1,371 @@
+#ifndef MESHSIMPLIFY_H
+#define MESHSIMPLIFY_H
+
+#include <glm/glm.hpp>
+
+#include <mesh.h>
+#include <meshoptimize.h>
+#include <vertexlayout.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+using namespace std;
+
+// Mesh simplification
+// -------------------
+// Edge collapse driven by quadric error metrics (Garland & Heckbert). A vertex is only ever
+// collapsed onto another existing vertex, so every LOD is just a shorter index list over the same
+// vertex buffer. Vertices sharing a position with different attributes (UV or normal seams) are
+// "wedges" of the same point; seams and open borders only collapse along themselves, so their
+// outline and attributes survive, and points where they meet in more complex ways never move.
+
+// simplified levels are built while each one still drops at least this share of the previous
+#define LOD_MIN_REDUCTION 0.1f
+
+// Symmetric 4x4 matrix of summed squared plane distances, divided by the summed weight so the
+// error is a squared distance in object units whatever the triangle sizes
+struct Quadric
+{
+	double a[10]; // xx xy xz xw yy yz yw zz zw ww
+	double weight;
+
+	Quadric() : weight(0.0) { memset(a, 0, sizeof(a)); }
+
+	// plane n.p + d = 0, n unit length
+	static Quadric Plane(const glm::vec3 &n, float d, float weight) {
+		Quadric q;
+		double x = n.x, y = n.y, z = n.z, w = d;
+		q.a[0] = x * x; q.a[1] = x * y; q.a[2] = x * z; q.a[3] = x * w;
+		q.a[4] = y * y; q.a[5] = y * z; q.a[6] = y * w;
+		q.a[7] = z * z; q.a[8] = z * w;
+		q.a[9] = w * w;
+		for (unsigned int i = 0; i < 10; i++) q.a[i] *= weight;
+		q.weight = weight;
+		return q;
+	}
+
+	Quadric& operator+=(const Quadric &other) {
+		for (unsigned int i = 0; i < 10; i++) a[i] += other.a[i];
+		weight += other.weight;
+		return *this;
+	}
+
+	double Error(const glm::vec3 &p) const {
+		double x = p.x, y = p.y, z = p.z;
+		double e = a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z + 2.0 * a[3] * x
+			+ a[4] * y * y + 2.0 * a[5] * y * z + 2.0 * a[6] * y
+			+ a[7] * z * z + 2.0 * a[8] * z + a[9];
+		return weight > 0.0 ? fabs(e) / weight : 0.0;
+	}
+};
+
+// Reduces 'indices' (a triangle list over 'vertices') to about 'targetIndexCount' indices.
+// 'error' is raised to the largest distance a collapse moved the surface, in object units.
+inline void SimplifyMesh(const vector<Vertex> &vertices, vector<unsigned int> &indices, unsigned int targetIndexCount, float &error)
+{
+	enum VertexKind { KIND_MANIFOLD, KIND_BORDER, KIND_SEAM, KIND_LOCKED };
+	const unsigned int vertexCount = (unsigned int)vertices.size();
+	if (indices.size() <= targetIndexCount || vertexCount == 0) return;
+
+	// wedges: 'point' is the first vertex with the same position, 'nextWedge' a ring over them
+	vector<unsigned int> point(vertexCount), nextWedge(vertexCount);
+	{
+		unsigned int tableSize = 1;
+		while (tableSize < vertexCount * 2) tableSize <<= 1;
+		vector<int> table(tableSize, -1);
+		for (unsigned int v = 0; v < vertexCount; v++) {
+			glm::vec3 p = vertices[v].Position + glm::vec3(0.0f); // -0 and +0 are the same point
+			uint32_t bits[3];
+			memcpy(bits, &p, sizeof(bits));
+			uint32_t hash = (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+			unsigned int slot = hash & (tableSize - 1);
+			while (table[slot] >= 0 && vertices[table[slot]].Position != p)
+				slot = (slot + 1) & (tableSize - 1);
+			if (table[slot] < 0) {
+				table[slot] = (int)v;
+				point[v] = v;
+				nextWedge[v] = v;
+			}
+			else {
+				unsigned int first = (unsigned int)table[slot];
+				point[v] = first;
+				nextWedge[v] = nextWedge[first];
+				nextWedge[first] = v;
+			}
+		}
+	}
+
+	// open edges in attribute space: an edge of a triangle with no triangle running the other way
+	// over the same two vertices. openOut/openIn hold the other end, -1 for none, -2 for several.
+	vector<int> openOut(vertexCount, -1), openIn(vertexCount, -1);
+	vector<bool> pointBorder(vertexCount, false); // open in position space too
+	{
+		vector<pair<uint64_t, unsigned int> > edges; // (from << 32 | to), counted per direction
+		vector<pair<uint64_t, unsigned int> > pointEdges;
+		edges.reserve(indices.size());
+		pointEdges.reserve(indices.size());
+		for (size_t i = 0; i < indices.size(); i += 3) {
+			for (unsigned int k = 0; k < 3; k++) {
+				unsigned int a = indices[i + k], b = indices[i + (k + 1) % 3];
+				edges.push_back(make_pair(((uint64_t)a << 32) | b, 0u));
+				pointEdges.push_back(make_pair(((uint64_t)point[a] << 32) | point[b], 0u));
+			}
+		}
+		sort(edges.begin(), edges.end());
+		sort(pointEdges.begin(), pointEdges.end());
+		auto hasEdge = [](const vector<pair<uint64_t, unsigned int> > &list, uint64_t key) {
+			return binary_search(list.begin(), list.end(), make_pair(key, 0u));
+		};
+		for (size_t i = 0; i < edges.size(); i++) {
+			if (i > 0 && edges[i].first == edges[i - 1].first) continue;
+			unsigned int a = (unsigned int)(edges[i].first >> 32), b = (unsigned int)(edges[i].first & 0xFFFFFFFFu);
+			if (hasEdge(edges, ((uint64_t)b << 32) | a)) continue;
+			openOut[a] = openOut[a] == -1 ? (int)b : -2;
+			openIn[b] = openIn[b] == -1 ? (int)a : -2;
+			if (!hasEdge(pointEdges, ((uint64_t)point[b] << 32) | point[a]))
+				pointBorder[point[a]] = pointBorder[point[b]] = true;
+		}
+		// an edge used twice in the same direction is non-manifold: lock its ends
+		for (size_t i = 1; i < pointEdges.size(); i++) {
+			if (pointEdges[i].first == pointEdges[i - 1].first) {
+				openOut[pointEdges[i].first >> 32] = -2;
+				openOut[pointEdges[i].first & 0xFFFFFFFFu] = -2;
+			}
+		}
+	}
+
+	vector<unsigned char> kind(vertexCount, KIND_LOCKED);
+	for (unsigned int v = 0; v < vertexCount; v++) {
+		if (point[v] != v) continue;
+		unsigned int wedges = 0;
+		bool locked = false;
+		unsigned int w = v;
+		do {
+			wedges++;
+			if (openOut[w] == -2 || openIn[w] == -2 || (openOut[w] == -1) != (openIn[w] == -1)) locked = true;
+			w = nextWedge[w];
+		} while (w != v);
+
+		unsigned char k = KIND_LOCKED;
+		if (!locked && wedges == 1)
+			k = openOut[v] == -1 ? KIND_MANIFOLD : KIND_BORDER;
+		else if (!locked && wedges == 2 && !pointBorder[v]) {
+			// two sides of a seam: what leaves one wedge arrives at the other
+			unsigned int o = nextWedge[v];
+			if (openOut[v] >= 0 && openOut[o] >= 0 &&
+				point[openOut[v]] == point[openIn[o]] && point[openIn[v]] == point[openOut[o]])
+				k = KIND_SEAM;
+		}
+		w = v;
+		do {
+			kind[w] = k;
+			w = nextWedge[w];
+		} while (w != v);
+	}
+
+	// quadrics per point: triangle planes weighted by area, plus planes through the border and
+	// seam edges, perpendicular to their triangle, so the outlines keep their shape
+	vector<Quadric> quadrics(vertexCount);
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		const glm::vec3 &p0 = vertices[indices[i]].Position;
+		const glm::vec3 &p1 = vertices[indices[i + 1]].Position;
+		const glm::vec3 &p2 = vertices[indices[i + 2]].Position;
+		glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+		float area = glm::length(n);
+		if (area <= 0.0f) continue;
+		n /= area;
+		Quadric plane = Quadric::Plane(n, -glm::dot(n, p0), area * 0.5f);
+		for (unsigned int k = 0; k < 3; k++) {
+			unsigned int a = indices[i + k], b = indices[i + (k + 1) % 3];
+			quadrics[point[a]] += plane;
+			if (openOut[a] == (int)b) {
+				glm::vec3 edge = vertices[b].Position - vertices[a].Position;
+				float length = glm::length(edge);
+				if (length <= 0.0f) continue;
+				glm::vec3 side = glm::normalize(glm::cross(edge, n));
+				Quadric border = Quadric::Plane(side, -glm::dot(side, vertices[a].Position), length * length * 10.0f);
+				quadrics[point[a]] += border;
+				quadrics[point[b]] += border;
+			}
+		}
+	}
+
+	struct Collapse
+	{
+		unsigned int from, to;
+		float        cost;
+		bool operator<(const Collapse &other) const { return cost < other.cost; }
+	};
+
+	double maxCost = (double)error * (double)error;
+	vector<Collapse> collapses;
+	vector<unsigned int> remap(vertexCount);
+	vector<bool> locked(vertexCount);
+	vector<unsigned int> firstTriangle(vertexCount + 1), adjacency;
+
+	// u collapsed onto v along an open edge: the vertex before or after u on the outline is now
+	// linked to v
+	auto relink = [&](unsigned int u, unsigned int v) {
+		if (openOut[u] == (int)v) {
+			openIn[v] = openIn[u];
+			if (openIn[u] >= 0) openOut[openIn[u]] = (int)v;
+		}
+		else if (openIn[u] == (int)v) {
+			openOut[v] = openOut[u];
+			if (openOut[u] >= 0) openIn[openOut[u]] = (int)v;
+		}
+	};
+
+	while (indices.size() > targetIndexCount) {
+		const unsigned int triangleCount = (unsigned int)(indices.size() / 3);
+
+		// triangles around every point (all its wedges)
+		fill(firstTriangle.begin(), firstTriangle.end(), 0u);
+		for (size_t i = 0; i < indices.size(); i++)
+			firstTriangle[point[indices[i]] + 1]++;
+		for (unsigned int v = 0; v < vertexCount; v++)
+			firstTriangle[v + 1] += firstTriangle[v];
+		adjacency.resize(indices.size());
+		{
+			vector<unsigned int> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+			for (unsigned int t = 0; t < triangleCount; t++)
+				for (unsigned int k = 0; k < 3; k++)
+					adjacency[filled[point[indices[t * 3 + k]]]++] = t;
+		}
+
+		// every edge a collapse may follow, with its cost
+		collapses.clear();
+		for (unsigned int t = 0; t < triangleCount; t++) {
+			for (unsigned int k = 0; k < 3; k++) {
+				unsigned int u = indices[t * 3 + k], v = indices[t * 3 + (k + 1) % 3];
+				for (unsigned int dir = 0; dir < 2; dir++, swap(u, v)) {
+					bool allowed = kind[u] == KIND_MANIFOLD ||
+						((kind[u] == KIND_BORDER || kind[u] == KIND_SEAM) && kind[v] == kind[u] && (openOut[u] == (int)v || openIn[u] == (int)v));
+					if (!allowed) continue;
+					Quadric q = quadrics[point[u]];
+					q += quadrics[point[v]];
+					Collapse collapse = { u, v, (float)q.Error(vertices[v].Position) };
+					collapses.push_back(collapse);
+				}
+			}
+		}
+		if (collapses.empty()) break;
+		sort(collapses.begin(), collapses.end());
+
+		for (unsigned int v = 0; v < vertexCount; v++) remap[v] = v;
+		fill(locked.begin(), locked.end(), false);
+		size_t removedIndices = 0, toRemove = indices.size() - targetIndexCount;
+		unsigned int applied = 0;
+		for (size_t c = 0; c < collapses.size() && removedIndices < toRemove; c++) {
+			unsigned int u = collapses[c].from, v = collapses[c].to;
+			unsigned int pu = point[u], pv = point[v];
+			if (locked[pu] || locked[pv]) continue;
+
+			// no triangle around u may flip, and the ones between u and v go away
+			const glm::vec3 &target = vertices[v].Position;
+			bool flips = false;
+			unsigned int removed = 0;
+			for (unsigned int j = firstTriangle[pu]; j < firstTriangle[pu + 1] && !flips; j++) {
+				const unsigned int *tri = &indices[adjacency[j] * 3];
+				glm::vec3 p[3], q[3];
+				bool hasV = false;
+				for (unsigned int k = 0; k < 3; k++) {
+					p[k] = q[k] = vertices[tri[k]].Position;
+					if (point[tri[k]] == pu) q[k] = target;
+					if (point[tri[k]] == pv) hasV = true;
+				}
+				if (hasV) {
+					removed++;
+					continue;
+				}
+				glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+				glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+				// turning by more than ~75 degrees counts too: it leaves slivers standing across the surface
+				if (glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after)) flips = true;
+			}
+			if (flips) continue;
+
+			// every wedge of u goes to the wedge of v on its side
+			remap[u] = v;
+			if (kind[u] == KIND_BORDER)
+				relink(u, v);
+			else if (kind[u] == KIND_SEAM) {
+				unsigned int otherU = nextWedge[u], otherV = nextWedge[v];
+				remap[otherU] = otherV;
+				relink(u, v);
+				relink(otherU, otherV);
+			}
+			quadrics[pv] += quadrics[pu];
+			maxCost = max(maxCost, (double)collapses[c].cost);
+			removedIndices += removed * 3;
+			applied++;
+
+			// the points whose triangles changed wait for the next pass
+			for (unsigned int j = firstTriangle[pu]; j < firstTriangle[pu + 1]; j++)
+				for (unsigned int k = 0; k < 3; k++)
+					locked[point[indices[adjacency[j] * 3 + k]]] = true;
+		}
+		if (applied == 0) break;
+
+		// rewrite the triangles, dropping the ones left without area in position space
+		size_t write = 0;
+		for (size_t i = 0; i < indices.size(); i += 3) {
+			unsigned int a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+			if (point[a] == point[b] || point[b] == point[c] || point[a] == point[c]) continue;
+			indices[write++] = a;
+			indices[write++] = b;
+			indices[write++] = c;
+		}
+		indices.resize(write);
+	}
+
+	error = (float)sqrt(maxCost);
+}
+
+// Appends up to 'levels' simplified versions of the first LOD in 'indices', each with about half
+// the triangles of the previous one and its own vertex cache order. 'lods' gets one entry per
+// level, the full mesh included.
+inline void BuildLodChain(const vector<Vertex> &vertices, vector<unsigned int> &indices, unsigned int levels, vector<MeshLod> &lods)
+{
+	lods.clear();
+	lods.push_back(MeshLod(0, (unsigned int)indices.size(), 0.0f));
+
+	vector<unsigned int> current(indices);
+	float error = 0.0f;
+	for (unsigned int level = 1; level <= levels; level++) {
+		unsigned int previous = (unsigned int)current.size();
+		unsigned int target = (previous / 2) / 3 * 3;
+		SimplifyMesh(vertices, current, target, error);
+		if (current.empty() || (float)current.size() > (float)previous * (1.0f - LOD_MIN_REDUCTION))
+			break;
+
+		vector<unsigned int> ordered(current);
+		OptimizeVertexCache(ordered, (unsigned int)vertices.size());
+		lods.push_back(MeshLod((unsigned int)indices.size(), (unsigned int)ordered.size(), error));
+		indices.insert(indices.end(), ordered.begin(), ordered.end());
+	}
+}
+
+// one line per model: triangles of every level summed over its meshes
+inline void PrintLodChain(const string &name, const vector<vector<MeshLod> > &meshLods)
+{
+	size_t levels = 0;
+	for (size_t m = 0; m < meshLods.size(); m++)
+		levels = max(levels, meshLods[m].size());
+	vector<unsigned long long> triangles(levels, 0);
+	for (size_t m = 0; m < meshLods.size(); m++)
+		for (size_t l = 0; l < levels && !meshLods[m].empty(); l++) // meshes with fewer levels count their last one
+			triangles[l] += meshLods[m][min(l, meshLods[m].size() - 1)].indexCount / 3;
+	if (triangles.size() <= 1) return;
+	cout << "LOD: " << name << ":";
+	for (size_t l = 0; l < triangles.size(); l++)
+		cout << (l == 0 ? " " : " -> ") << triangles[l];
+	cout << " triangles" << endl;
+}
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef MESHWELD_H
+#define MESHWELD_H
+
+#include <glm/glm.hpp>
+
+#include <mesh.h>
+#include <modelstructs.h>
+#include <vertexlayout.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+using namespace std;
+
+// Vertex welding
+// --------------
+// The importer does not ask Assimp to join identical vertices, so FBX meshes arrive with a
+// vertex per face corner. WeldVertices merges the vertices that would reach the GPU as the same
+// bytes: they are compared packed with the mesh VertexLayout, so two normals that quantize to
+// the same 10:10:10:2 value weld even if their floats differ. With an epsilon the positions are
+// snapped to a grid of that size before comparing (two points closer than epsilon can still
+// fall in different cells, so it merges most near duplicates, not all of them).
+
+// Vertex and index savings of the welding, per mesh or summed over a model
+struct MeshWeldStats
+{
+	unsigned int       meshes;
+	unsigned int       shortIndexMeshes;  // meshes left with fewer than 65536 vertices, drawn with 16-bit indices
+	unsigned long long verticesBefore;
+	unsigned long long verticesAfter;
+	unsigned long long indices;
+	unsigned long long vertexBytesBefore;
+	unsigned long long vertexBytesAfter;
+	unsigned long long indexBytesBefore;  // all 32-bit
+	unsigned long long indexBytesAfter;
+
+	MeshWeldStats() : meshes(0), shortIndexMeshes(0), verticesBefore(0), verticesAfter(0), indices(0),
+		vertexBytesBefore(0), vertexBytesAfter(0), indexBytesBefore(0), indexBytesAfter(0) {}
+
+	void Add(const MeshWeldStats &other) {
+		meshes += other.meshes;
+		shortIndexMeshes += other.shortIndexMeshes;
+		verticesBefore += other.verticesBefore;
+		verticesAfter += other.verticesAfter;
+		indices += other.indices;
+		vertexBytesBefore += other.vertexBytesBefore;
+		vertexBytesAfter += other.vertexBytesAfter;
+		indexBytesBefore += other.indexBytesBefore;
+		indexBytesAfter += other.indexBytesAfter;
+	}
+
+	void Print(const string &name) const {
+		if (meshes == 0) return;
+		cout << "Weld: " << name << ": " << verticesBefore << " -> " << verticesAfter << " vertices ("
+			<< (verticesBefore > 0 ? 100.0f * (float)verticesAfter / (float)verticesBefore : 100.0f) << "%), vertex KB "
+			<< vertexBytesBefore / 1024 << " -> " << vertexBytesAfter / 1024 << ", index KB "
+			<< indexBytesBefore / 1024 << " -> " << indexBytesAfter / 1024 << ", "
+			<< shortIndexMeshes << " of " << meshes << " meshes with 16-bit indices" << endl;
+	}
+};
+
+// Merges the vertices with the same packed bytes and rewrites the indices to use the first of
+// each group; the vertices keep their first-use order. 'epsilon' > 0 snaps the positions.
+inline MeshWeldStats WeldVertices(vector<Vertex> &vertices, vector<unsigned int> &indices, const VertexLayout &layout, float epsilon = 0.0f)
+{
+	MeshWeldStats stats;
+	const unsigned int count = (unsigned int)vertices.size();
+	stats.meshes = 1;
+	stats.verticesBefore = count;
+	stats.indices = indices.size();
+	stats.vertexBytesBefore = layout.Size(count);
+	stats.indexBytesBefore = indices.size() * sizeof(unsigned int);
+
+	if (count > 0) {
+		vector<unsigned char> packed(layout.Size(count));
+		layout.Pack(vertices.data(), count, packed.data());
+
+		// key of a vertex: its position (canonical floats, or grid cell) and then its bytes in
+		// every other stream
+		const unsigned int keySize = layout.stride;
+		vector<unsigned char> keys((size_t)count * keySize);
+		for (unsigned int i = 0; i < count; i++) {
+			unsigned char *key = &keys[(size_t)i * keySize];
+			const glm::vec3 &position = vertices[i].Position;
+			for (unsigned int c = 0; c < 3; c++) {
+				if (epsilon > 0.0f) {
+					int32_t cell = (int32_t)floorf(position[c] / epsilon + 0.5f);
+					memcpy(key + c * 4, &cell, 4);
+				}
+				else {
+					float value = position[c] + 0.0f; // -0 and +0 weld
+					memcpy(key + c * 4, &value, 4);
+				}
+			}
+			unsigned int offset = layout.streamStrides[STREAM_POSITION];
+			for (unsigned int s = STREAM_SHADING; s < VERTEX_STREAM_COUNT; s++) {
+				if (layout.streamStrides[s] == 0) continue;
+				memcpy(key + offset, &packed[layout.StreamOffset(s, count) + (size_t)i * layout.streamStrides[s]], layout.streamStrides[s]);
+				offset += layout.streamStrides[s];
+			}
+		}
+
+		// open addressing table of unique vertices, at most half full
+		unsigned int tableSize = 1;
+		while (tableSize < count * 2) tableSize <<= 1;
+		vector<int> table(tableSize, -1);
+		vector<unsigned int> remap(count);
+		vector<Vertex> welded;
+		welded.reserve(count);
+		vector<unsigned int> firstOf; // original vertex of every welded one
+		firstOf.reserve(count);
+		for (unsigned int i = 0; i < count; i++) {
+			const unsigned char *key = &keys[(size_t)i * keySize];
+			unsigned int slot = (unsigned int)HashBytes(key, keySize) & (tableSize - 1);
+			while (table[slot] >= 0 && memcmp(&keys[(size_t)firstOf[table[slot]] * keySize], key, keySize) != 0)
+				slot = (slot + 1) & (tableSize - 1);
+			if (table[slot] < 0) {
+				table[slot] = (int)welded.size();
+				firstOf.push_back(i);
+				welded.push_back(vertices[i]);
+			}
+			remap[i] = (unsigned int)table[slot];
+		}
+
+		for (size_t i = 0; i < indices.size(); i++)
+			indices[i] = remap[indices[i]];
+		vertices.swap(welded);
+	}
+
+	stats.verticesAfter = vertices.size();
+	stats.vertexBytesAfter = layout.Size((unsigned int)vertices.size());
+	GLenum indexType = MeshIndexType((unsigned int)vertices.size());
+	stats.shortIndexMeshes = indexType == GL_UNSIGNED_SHORT ? 1 : 0;
+	stats.indexBytesAfter = indices.size() * MeshIndexSize(indexType);
+	return stats;
+}
+
+#endif
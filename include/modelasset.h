@@ -0,0 +1,76 @@
+#ifndef MODELASSET_H
+#define MODELASSET_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <shader.h>
+#include <model.h>
+#include <animatedmodel.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Geometry, textures, bones and clips of a model file, loaded once and never changed afterwards.
+// Every user of the file shares the same asset, so the meshes and textures exist a single time
+// in VRAM no matter how many copies are drawn.
+class ModelAsset
+{
+public:
+	// 'animated' keeps the skeleton and clips (it goes through AnimatedModel, which never takes
+	// them from the mesh cache)
+	ModelAsset(const string &path, const ModelLoadOptions &options = ModelLoadOptions(), bool animated = false)
+		: path(path)
+	{
+		if (animated)
+			animatedModel.reset(new AnimatedModel(path, options));
+		else
+			model.reset(new Model(path, options));
+	}
+
+	// GL objects of an asset loaded with deferUpload, context thread only
+	void Upload() {
+		if (model) model->Upload();
+		else animatedModel->Upload();
+	}
+
+	bool IsUploaded() const { return model ? model->IsUploaded() : animatedModel->IsUploaded(); }
+
+	const string& Path() const { return path; }
+
+	const vector<Mesh>& Meshes() const { return model ? model->meshes : animatedModel->meshes; }
+	const vector<Bone>& Bones() const { return model ? model->bones : animatedModel->bones; }
+	const Skeleton& GetSkeleton() const { return model ? model->skeleton : animatedModel->skeleton; }
+	const glm::mat4& GlobalInverseTransform() const { return model ? model->m_GlobalInverseTransform : animatedModel->m_GlobalInverseTransform; }
+
+	GeometryMemory Memory() const { return model ? model->Memory() : animatedModel->Memory(); }
+
+	bool IsAnimated() const { return !GetSkeleton().clips.empty() && !Bones().empty(); }
+
+	// draws every mesh, textures of a type found in textureOverrides are replaced by the given one.
+	// 'lodLevels' has the level of detail of every mesh, the full meshes are drawn without it, and
+	// 'culler' skips what the camera can not see.
+	void Draw(const Shader &shader, const map<string, unsigned int> *textureOverrides = nullptr, const vector<unsigned int> *lodLevels = nullptr,
+		const MeshletCuller *culler = nullptr) const {
+		const vector<Mesh> &meshes = Meshes();
+		if (model && model->Geometry()) {
+			model->Geometry()->Draw(shader, meshes, textureOverrides, lodLevels, culler);
+			return;
+		}
+		for (unsigned int i = 0; i < meshes.size(); i++)
+			meshes[i].Draw(shader, textureOverrides, lodLevels != nullptr && i < lodLevels->size() ? (*lodLevels)[i] : 0, culler);
+	}
+
+private:
+	string                    path;
+	unique_ptr<Model>         model;
+	unique_ptr<AnimatedModel> animatedModel;
+
+	ModelAsset(const ModelAsset&);
+	ModelAsset& operator=(const ModelAsset&);
+};
+
+#endif
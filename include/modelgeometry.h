@@ -0,0 +1,288 @@
+#ifndef MODELGEOMETRY_H
+#define MODELGEOMETRY_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <mesh.h>
+#include <meshlet.h>
+#include <shader.h>
+#include <vertexlayout.h>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Merged geometry of a model
+// --------------------------
+// Every Mesh owns a vertex buffer, an element buffer and a VAO, so a model made of a few hundred
+// sub-meshes costs as many VAO binds and draw calls every frame. ModelGeometry copies them into a
+// single vertex buffer and a single element buffer. The meshes with the same vertex layout and
+// index type share a region of both buffers and one VAO: the region holds each vertex stream of
+// all of them one after the other (the blocks of a single mesh, only longer), and the indices
+// stay relative to the first vertex of their mesh, which glMultiDrawElementsBaseVertex adds back.
+// The meshes of a region that use the same textures form a batch, drawn with one call once its
+// textures are bound, so the model costs a VAO bind per region and a draw per material.
+class ModelGeometry
+{
+public:
+	ModelGeometry() : VBO(0), EBO(0), vertexBytes(0), indexBytes(0) {}
+
+	~ModelGeometry() {
+		for (unsigned int r = 0; r < regions.size(); r++) {
+			for (map<unsigned int, unsigned int>::iterator it = regions[r].vertexArrays.begin(); it != regions[r].vertexArrays.end(); ++it)
+				glDeleteVertexArrays(1, &it->second);
+			glDeleteVertexArrays(1, &regions[r].VAO);
+		}
+		if (VBO != 0) glDeleteBuffers(1, &VBO);
+		if (EBO != 0) glDeleteBuffers(1, &EBO);
+	}
+
+	// Copies the buffers of the uploaded 'meshes' on the GPU, so it works for meshes built from
+	// the mesh cache too (they keep no CPU vertices). Context thread only.
+	void Build(const vector<Mesh> &meshes) {
+		placements.assign(meshes.size(), Placement());
+
+		// regions, and where every mesh goes inside its region
+		map<pair<uint32_t, GLenum>, unsigned int> regionOf;
+		for (unsigned int i = 0; i < meshes.size(); i++) {
+			const Mesh &mesh = meshes[i];
+			if (!mesh.IsUploaded() || mesh.vertexCount == 0 || mesh.indexCount == 0) continue;
+			pair<uint32_t, GLenum> key(mesh.layout.Key(), mesh.indexType);
+			map<pair<uint32_t, GLenum>, unsigned int>::iterator found = regionOf.find(key);
+			if (found == regionOf.end()) {
+				found = regionOf.insert(make_pair(key, (unsigned int)regions.size())).first;
+				regions.push_back(Region(mesh.layout, mesh.indexType));
+			}
+			Region &region = regions[found->second];
+			Placement &placement = placements[i];
+			placement.region = found->second;
+			placement.baseVertex = (GLint)region.vertexCount;
+			placement.indexOffset = region.indexBytes; // relative to the region until the offsets are known
+			region.vertexCount += mesh.vertexCount;
+			region.indexBytes += mesh.IndexBytes();
+		}
+		if (regions.empty()) return;
+
+		// the regions one after the other, aligned for any attribute and index type
+		for (unsigned int r = 0; r < regions.size(); r++) {
+			regions[r].vertexOffset = vertexBytes;
+			vertexBytes += align(regions[r].layout.Size(regions[r].vertexCount));
+			regions[r].indexOffset = indexBytes;
+			indexBytes += align(regions[r].indexBytes);
+		}
+		for (unsigned int i = 0; i < placements.size(); i++)
+			if (placements[i].region != NO_REGION)
+				placements[i].indexOffset += regions[placements[i].region].indexOffset;
+
+		glGenBuffers(1, &VBO);
+		glGenBuffers(1, &EBO);
+
+		// stream by stream, each mesh block lands at its base vertex in the region block
+		glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+		glBufferData(GL_COPY_WRITE_BUFFER, vertexBytes, nullptr, GL_STATIC_DRAW);
+		for (unsigned int i = 0; i < meshes.size(); i++) {
+			const Placement &placement = placements[i];
+			if (placement.region == NO_REGION) continue;
+			const Mesh &mesh = meshes[i];
+			const Region &region = regions[placement.region];
+			glBindBuffer(GL_COPY_READ_BUFFER, mesh.VertexBuffer());
+			for (unsigned int s = 0; s < VERTEX_STREAM_COUNT; s++) {
+				unsigned int stride = region.layout.streamStrides[s];
+				if (stride == 0) continue;
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, mesh.layout.StreamOffset(s, mesh.vertexCount),
+					region.vertexOffset + region.layout.StreamOffset(s, region.vertexCount) + (size_t)placement.baseVertex * stride,
+					(size_t)stride * mesh.vertexCount);
+			}
+		}
+
+		glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+		glBufferData(GL_COPY_WRITE_BUFFER, indexBytes, nullptr, GL_STATIC_DRAW);
+		for (unsigned int i = 0; i < meshes.size(); i++) {
+			if (placements[i].region == NO_REGION) continue;
+			glBindBuffer(GL_COPY_READ_BUFFER, meshes[i].IndexBuffer());
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, placements[i].indexOffset, meshes[i].IndexBytes());
+		}
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		for (unsigned int r = 0; r < regions.size(); r++)
+			regions[r].VAO = createVertexArray(regions[r], ~0u);
+
+		// batches in region order, so the VAO only changes between regions
+		for (unsigned int r = 0; r < regions.size(); r++) {
+			unsigned int first = (unsigned int)batches.size();
+			for (unsigned int i = 0; i < meshes.size(); i++) {
+				if (placements[i].region != r) continue;
+				unsigned int b = first;
+				while (b < batches.size() && !sameTextures(batches[b].textures, meshes[i].textures))
+					b++;
+				if (b == batches.size()) {
+					batches.push_back(Batch());
+					batches.back().region = r;
+					batches.back().textures = meshes[i].textures;
+				}
+				batches[b].meshes.push_back(i);
+			}
+		}
+	}
+
+	bool IsBuilt() const { return VBO != 0; }
+
+	// Draws 'meshes' (the ones given to Build) batch by batch, textures of a type found in
+	// textureOverrides replaced by the given one. 'lodLevels' has the level of detail of every
+	// mesh, the full meshes are drawn without it, and 'culler' skips what the camera can not see.
+	void Draw(const Shader &shader, const vector<Mesh> &meshes, const map<string, unsigned int> *textureOverrides = nullptr,
+		const vector<unsigned int> *lodLevels = nullptr, const MeshletCuller *culler = nullptr) const {
+		unsigned int boundRegion = NO_REGION;
+		for (unsigned int b = 0; b < batches.size(); b++) {
+			const Batch &batch = batches[b];
+			const Region &region = regions[batch.region];
+			const size_t indexSize = MeshIndexSize(region.indexType);
+			counts.clear();
+			offsets.clear();
+			baseVertices.clear();
+			for (unsigned int m = 0; m < batch.meshes.size(); m++) {
+				const unsigned int i = batch.meshes[m];
+				const Mesh &mesh = meshes[i];
+				const Placement &placement = placements[i];
+				unsigned int lod = lodLevels != nullptr && i < lodLevels->size() ? (*lodLevels)[i] : 0;
+				lod = min(lod, (unsigned int)mesh.lods.size() - 1);
+				if (culler != nullptr) {
+					glm::vec3 center = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+					if (!culler->SphereVisible(center, glm::length(mesh.boundsMax - mesh.boundsMin) * 0.5f)) {
+						culler->MeshCulled();
+						continue;
+					}
+					if (lod == 0 && !mesh.meshlets.empty()) {
+						// ranges of the mesh element buffer, moved to where it was copied
+						GLsizei ranges = culler->Collect(mesh.meshlets, indexSize);
+						for (GLsizei r = 0; r < ranges; r++)
+							add(culler->Counts()[r], placement.indexOffset + (uintptr_t)culler->Offsets()[r], placement.baseVertex);
+						continue;
+					}
+				}
+				const MeshLod &level = mesh.lods[lod];
+				if (level.indexCount > 0)
+					add((GLsizei)level.indexCount, placement.indexOffset + level.indexOffset * indexSize, placement.baseVertex);
+			}
+			if (counts.empty()) continue;
+
+			BindMeshTextures(shader, batch.textures, textureOverrides);
+			if (batch.region != boundRegion) {
+				glBindVertexArray(vertexArrayFor(region, shader.attributeMask));
+				boundRegion = batch.region;
+			}
+			glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), region.indexType, offsets.data(), (GLsizei)counts.size(), baseVertices.data());
+		}
+		glBindVertexArray(0);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	// bytes of the shared buffers
+	size_t GpuBytes() const { return IsBuilt() ? vertexBytes + indexBytes : 0; }
+
+	// one line per model
+	void Print(const string &name, size_t meshCount) const {
+		if (!IsBuilt()) return;
+		cout << "Geometry: " << name << ": " << meshCount << " meshes -> " << batches.size() << " draws in " << regions.size()
+			<< " vertex arrays, vertex KB " << vertexBytes / 1024 << ", index KB " << indexBytes / 1024 << endl;
+	}
+
+private:
+	static const unsigned int NO_REGION = ~0u;
+
+	// meshes of the same vertex layout and index type
+	struct Region
+	{
+		VertexLayout layout;
+		GLenum       indexType;
+		unsigned int vertexCount;
+		size_t       vertexOffset; // bytes, in VBO
+		size_t       indexOffset;  // bytes, in EBO
+		size_t       indexBytes;
+		unsigned int VAO;
+		mutable map<unsigned int, unsigned int> vertexArrays; // VAO per set of attributes, besides the full one
+
+		Region(const VertexLayout &layout, GLenum indexType)
+			: layout(layout), indexType(indexType), vertexCount(0), vertexOffset(0), indexOffset(0), indexBytes(0), VAO(0) {}
+	};
+
+	// where a mesh was copied
+	struct Placement
+	{
+		unsigned int region;      // NO_REGION for a mesh with nothing to draw
+		GLint        baseVertex;  // first vertex in the region
+		size_t       indexOffset; // bytes, in EBO
+
+		Placement() : region(NO_REGION), baseVertex(0), indexOffset(0) {}
+	};
+
+	// meshes of a region drawn with the same textures
+	struct Batch
+	{
+		unsigned int         region;
+		vector<Texture>      textures;
+		vector<unsigned int> meshes;
+	};
+
+	unsigned int      VBO, EBO;
+	size_t            vertexBytes, indexBytes;
+	vector<Region>    regions;
+	vector<Placement> placements; // per mesh
+	vector<Batch>     batches;
+
+	// arguments of glMultiDrawElementsBaseVertex, kept so the frames do not allocate them again
+	mutable vector<GLsizei>     counts;
+	mutable vector<const void*> offsets;
+	mutable vector<GLint>       baseVertices;
+
+	ModelGeometry(const ModelGeometry&);
+	ModelGeometry& operator=(const ModelGeometry&);
+
+	static size_t align(size_t size) { return (size + 15) & ~(size_t)15; }
+
+	// the same texture names of the same types in the same order: the same material to draw with
+	static bool sameTextures(const vector<Texture> &a, const vector<Texture> &b) {
+		if (a.size() != b.size()) return false;
+		for (unsigned int i = 0; i < a.size(); i++)
+			if (a[i].id != b[i].id || a[i].type != b[i].type) return false;
+		return true;
+	}
+
+	void add(GLsizei count, size_t offset, GLint baseVertex) const {
+		counts.push_back(count);
+		offsets.push_back((const void*)(uintptr_t)offset);
+		baseVertices.push_back(baseVertex);
+	}
+
+	unsigned int createVertexArray(const Region &region, unsigned int mask) const {
+		unsigned int vao;
+		glGenVertexArrays(1, &vao);
+		glBindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		region.layout.Apply(region.vertexCount, mask, region.vertexOffset);
+		glBindVertexArray(0);
+		return vao;
+	}
+
+	// as Mesh::vertexArrayFor, the VAO of a region enabling only the attributes in 'mask'
+	unsigned int vertexArrayFor(const Region &region, unsigned int mask) const {
+		mask &= region.layout.AttributeMask();
+		if (mask == 0 || mask == region.layout.AttributeMask())
+			return region.VAO;
+
+		map<unsigned int, unsigned int>::const_iterator found = region.vertexArrays.find(mask);
+		if (found != region.vertexArrays.end())
+			return found->second;
+		unsigned int vao = createVertexArray(region, mask);
+		region.vertexArrays[mask] = vao;
+		return vao;
+	}
+};
+
+#endif
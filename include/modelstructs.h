@@ -12,19 +12,138 @@
 
 #include <mesh.h>
 #include <shader.h>
+#include <texturecontainer.h>
+#include <virtualfile.h>
+#include <loadprofiler.h>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <vector>
 #include <stdlib.h>
+#include <stdint.h>
 using namespace std;
 
 #include <glm/gtx/string_cast.hpp>
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+// Decoded image waiting to be uploaded. Decoding has no GL calls, so it can run on any thread.
+struct TextureImage
+{
+	unsigned char *data;
+	int            width;
+	int            height;
+	int            components;
+	string         path;
+	uint64_t       contentHash; // hash of the encoded file, 0 when unknown
+	unique_ptr<CompressedTexture> compressed; // baked container used instead of 'data' when there is one
+
+	TextureImage() : data(nullptr), width(0), height(0), components(0), contentHash(0) {}
+	TextureImage(TextureImage &&other) : data(other.data), width(other.width), height(other.height),
+		components(other.components), path(std::move(other.path)), contentHash(other.contentHash),
+		compressed(std::move(other.compressed)) {
+		other.data = nullptr;
+	}
+	TextureImage& operator=(TextureImage &&other) {
+		if (this != &other) {
+			if (data) stbi_image_free(data);
+			data = other.data;
+			width = other.width;
+			height = other.height;
+			components = other.components;
+			path = std::move(other.path);
+			contentHash = other.contentHash;
+			compressed = std::move(other.compressed);
+			other.data = nullptr;
+		}
+		return *this;
+	}
+	~TextureImage() {
+		if (data) stbi_image_free(data);
+	}
+
+	bool IsLoaded() const { return data != nullptr || compressed; }
+
+	// bytes the texture takes on the GPU, mip levels included
+	size_t GPUSize() const {
+		if (compressed) return compressed->Size();
+		return (size_t)width * height * components * 4 / 3; // a full mip chain adds a third
+	}
+
+private:
+	TextureImage(const TextureImage&);
+	TextureImage& operator=(const TextureImage&);
+};
+
+class TextureStreamer;
+
+// Options for importing a model
+struct ModelLoadOptions
+{
+	// Leave every GL call (buffers and textures) for Upload(), so the model can be imported
+	// on a worker thread and finished later on the thread that owns the context.
+	bool deferUpload;
+
+	// Convert the meshes of the model on several threads. Meant for the big assets with many
+	// sub-meshes, where a single model dominates the load time.
+	bool parallelMeshes;
+
+	// When set, textures start as 1x1 placeholders and the streamer swaps the real images in
+	// over the next frames, so the model can be drawn as soon as its geometry is uploaded.
+	TextureStreamer *streamer;
+
+	// Encoding of the vertex buffers (packed by default, VertexFormat::Full() for the old float
+	// vertices). The mesh cache is baked with it, so changing it makes the next load import again.
+	VertexFormat vertexFormat;
+
+	// Merge the vertices that pack to the same bytes (see meshweld.h): Assimp is not asked to
+	// join identical vertices, so FBX meshes arrive with one per face corner. A weldEpsilon
+	// above 0 also merges positions closer than about that distance.
+	bool  weldVertices;
+	float weldEpsilon;
+
+	// Reorder the triangles and vertices of every mesh for the vertex cache, overdraw and vertex
+	// fetch on import (see meshoptimize.h), printing ACMR/ATVR before and after. Costs import
+	// time only: the result is baked into the mesh cache.
+	bool optimizeMeshes;
+
+	// Simplified levels of detail built below every mesh (see meshsimplify.h), each with about
+	// half the triangles of the one before; 0 for none. Drawn through a LodView.
+	unsigned int lodLevels;
+
+	// Split the full meshes into meshlets with bounds and normal cones (see meshlet.h), so a draw
+	// with a CullView only submits the clusters the camera can see.
+	bool buildMeshlets;
+
+	// Copy all the meshes into one vertex buffer and one element buffer after the upload (see
+	// modelgeometry.h), so the model is drawn with a draw call per material instead of per mesh.
+	bool mergeGeometry;
+
+	// Most bone influences a skinned vertex keeps (4, 8 or the 12 a Vertex holds): the largest
+	// ones, renormalized. The vertices then carry only the bone groups they use and the model is
+	// drawn with the skinning shader variant of that count (see SkinningVertexShader), which does
+	// a bone fetch per influence. The mesh cache is baked with it.
+	unsigned int maxInfluences;
+
+	// What the meshes keep on the CPU once uploaded (see MeshCpuData): everything, which the
+	// default keeps for the code that reads the vertices back, the positions and indices for
+	// picking and collision, or nothing. Applied after the upload, and the merge when there is one.
+	MeshCpuData cpuData;
+
+	ModelLoadOptions() : deferUpload(false), parallelMeshes(false), streamer(nullptr), weldVertices(true), weldEpsilon(0.0f), optimizeMeshes(false),
+		lodLevels(0), buildMeshlets(false), mergeGeometry(false), maxInfluences(VERTEX_BONE_GROUPS * 4),
+		cpuData(MESH_CPU_KEEP) {}
+};
+
+bool ReadFileBytes(const string &filename, vector<unsigned char> &bytes);
+uint64_t HashBytes(const void *data, size_t size, uint64_t seed = 14695981039346656037ULL);
+TextureImage DecodeTextureImage(const string &filename, const vector<unsigned char> &bytes);
+TextureImage LoadTextureImage(const string &filename);
+GLenum TextureImageFormat(const TextureImage &image);
+unsigned int UploadTextureImage(const TextureImage &image);
+unsigned int TextureFromFile(const char *path, const string &directory);
 
 struct BoneInfo
 {
@@ -88,43 +207,124 @@ struct Bone {
 
 };
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+// through the VirtualFileSystem: from a mounted pack, or the disk
+bool ReadFileBytes(const string &filename, vector<unsigned char> &bytes)
 {
-    string filename = string(path);
-    filename = directory + '/' + filename;
+    return VirtualFileSystem::Get().ReadFile(filename, bytes);
+}
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+// 64-bit FNV-1a
+uint64_t HashBytes(const void *data, size_t size, uint64_t seed)
+{
+    const unsigned char *bytes = (const unsigned char*)data;
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// decodes an image file already read into memory, or loads its baked container when the
+// TextureBaker left an up to date one next to it
+TextureImage DecodeTextureImage(const string &filename, const vector<unsigned char> &bytes)
+{
+    TextureImage image;
+    image.path = filename;
+    if (!bytes.empty())
+        image.contentHash = HashBytes(bytes.data(), bytes.size());
+
+    unique_ptr<CompressedTexture> baked(new CompressedTexture());
+    bool hasContainer;
+    {
+        LoadTimer timer(filename, "texture", "container");
+        // the source image is decoded instead when the driver can not sample the blocks
+        hasContainer = baked->Load(filename) && BlockFormatSupported(baked->format);
+    }
+    if (hasContainer) {
+        LoadProfiler::Get().AddBytesRead(filename, "texture", baked->Size());
+        image.width = (int)baked->width;
+        image.height = (int)baked->height;
+        image.components = 4;
+        image.compressed = std::move(baked);
+        return image;
+    }
+
+    if (!bytes.empty()) {
+        LoadTimer timer(filename, "texture", "decode");
+        image.data = stbi_load_from_memory(bytes.data(), (int)bytes.size(), &image.width, &image.height, &image.components, 0);
+    }
+    if (!image.data)
+        std::cout << "Texture failed to load at path: " << filename << std::endl;
+    return image;
+}
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+TextureImage LoadTextureImage(const string &filename)
+{
+    vector<unsigned char> bytes;
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
+        LoadTimer timer(filename, "texture", "read");
+        ReadFileBytes(filename, bytes);
+    }
+    LoadProfiler::Get().AddBytesRead(filename, "texture", bytes.size());
+    return DecodeTextureImage(filename, bytes);
+}
+
+GLenum TextureImageFormat(const TextureImage &image)
+{
+    GLenum format = GL_RGBA;
+    if (image.components == 1)
+        format = GL_RED;
+    else if (image.components == 3)
+        format = GL_RGB;
+    else if (image.components == 4)
+        format = GL_RGBA;
+    return format;
+}
 
+unsigned int UploadTextureImage(const TextureImage &image)
+{
+    LoadTimer timer(image.path, "texture", "upload");
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    if (image.compressed)
+    {   // baked mip chain, nothing to generate
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        image.compressed->Upload(GL_TEXTURE_2D);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.compressed->levels.size() - 1);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
     }
-    else
+    else if (image.data)
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        GLenum format = TextureImageFormat(image);
+
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
+        {
+            LoadTimer mipTimer(image.path, "texture", "mipmaps");
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     }
 
+    if (image.IsLoaded())
+        LoadProfiler::Get().AddTextureBytes(image.path, "texture", image.GPUSize());
     return textureID;
 }
+
+unsigned int TextureFromFile(const char *path, const string &directory)
+{
+    string filename = JoinPath(directory, path);
+
+    return UploadTextureImage(LoadTextureImage(filename));
+}
 #endif
\ No newline at end of file
@@ -0,0 +1,204 @@
+#ifndef PROGRAMBINARYCACHE_H
+#define PROGRAMBINARYCACHE_H
+
+#include <glad/glad.h>
+
+#include <assetpack.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+using namespace std;
+
+// Program binary cache
+// --------------------
+// Linked programs are saved with glGetProgramBinary the first time they are built and given
+// back to the driver with glProgramBinary on later runs, which skips the GLSL compile and link.
+// A program has one file, "<hash of its stage paths and defines>.pbin" next to its vertex
+// shader:
+//
+//   ProgramBinaryHeader
+//   the binary, 'length' bytes
+//
+// The header keeps the hash of what the binary was built from (the sources with the defines
+// applied, and the vendor, renderer and version strings of the driver). A file whose key does
+// not match, or that the driver rejects, is rebuilt from source and overwritten.
+//
+// Program binaries are GL 4.1 (ARB_get_program_binary). We ask for a 3.3 context, so the cache
+// only works when the driver gave us more and glad loaded them; otherwise every program is
+// compiled as before.
+
+#define PROGRAM_BINARY_MAGIC     "PBIN"
+#define PROGRAM_BINARY_VERSION   1
+#define PROGRAM_BINARY_EXTENSION ".pbin"
+
+struct ProgramBinaryHeader
+{
+	char     magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint32_t format; // GLenum from glGetProgramBinary
+	uint32_t length;
+};
+
+class ProgramBinaryCache
+{
+public:
+	ProgramBinaryCache() : checked(false), supported(false), driverHash(0), loaded(0), stored(0), rebuilt(0) {}
+
+	// whether the driver can hand out program binaries. Queried the first time, with a context.
+	bool Supported() {
+		if (checked) return supported;
+		checked = true;
+		if (glad_glGetProgramBinary == NULL || glad_glProgramBinary == NULL || glad_glProgramParameteri == NULL)
+			return false;
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		if (formats <= 0) return false;
+
+		driverHash = hash(glString(GL_VENDOR), FNV_OFFSET);
+		driverHash = hash(glString(GL_RENDERER), driverHash);
+		driverHash = hash(glString(GL_VERSION), driverHash);
+		supported = true;
+		return true;
+	}
+
+	// key of a program built from these sources (defines applied) by this driver
+	uint64_t Key(const string &vertexCode, const string &fragmentCode, const string &geometryCode) const {
+		uint64_t key = hash(vertexCode, driverHash);
+		key = hash(fragmentCode, key);
+		return hash(geometryCode, key);
+	}
+
+	// file of a program, by its stage paths and defines
+	static string Path(const string &vertexPath, const string &fragmentPath, const string &geometryPath, const string &defines) {
+		uint64_t identity = hash(PackPathKey(vertexPath), FNV_OFFSET);
+		identity = hash(PackPathKey(fragmentPath), identity);
+		identity = hash(geometryPath.empty() ? string() : PackPathKey(geometryPath), identity);
+		identity = hash(defines, identity);
+
+		char name[17];
+		snprintf(name, sizeof(name), "%016llx", (unsigned long long)identity);
+		string vertex = NormalizePath(vertexPath);
+		size_t slash = vertex.find_last_of('/');
+		string directory = slash == string::npos ? string() : vertex.substr(0, slash + 1);
+		return directory + name + PROGRAM_BINARY_EXTENSION;
+	}
+
+	// Links 'program' from the binary stored in 'path' for 'key'. False when there is none, it
+	// was built from something else, or the driver does not take it (a driver update); the
+	// program is then left unlinked, to be built from source.
+	bool Load(GLuint program, const string &path, uint64_t key) {
+		ifstream in(path.c_str(), ios::binary);
+		if (!in) return false;
+
+		ProgramBinaryHeader header;
+		if (!in.read((char*)&header, sizeof(header)) || memcmp(header.magic, PROGRAM_BINARY_MAGIC, 4) != 0 ||
+			header.version != PROGRAM_BINARY_VERSION || header.key != key || header.length == 0) {
+			rebuilt++;
+			return false;
+		}
+		vector<char> binary(header.length);
+		if (!in.read(binary.data(), binary.size())) {
+			rebuilt++;
+			return false;
+		}
+
+		glProgramBinary(program, (GLenum)header.format, binary.data(), (GLsizei)binary.size());
+		GLint success = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success) {
+			cout << "WARNING::PROGRAMBINARYCACHE:: the driver rejected " << path << ", building from source" << endl;
+			rebuilt++;
+			return false;
+		}
+		loaded++;
+		return true;
+	}
+
+	// asks the driver to keep the binary of 'program', before it is linked
+	void Retrievable(GLuint program) {
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	// saves the binary of the linked 'program' as 'path', for 'key'
+	bool Store(GLuint program, const string &path, uint64_t key) {
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0) return false;
+		vector<char> binary(length);
+		GLenum format = 0;
+		glGetProgramBinary(program, length, &length, &format, binary.data());
+
+		ProgramBinaryHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, PROGRAM_BINARY_MAGIC, 4);
+		header.version = PROGRAM_BINARY_VERSION;
+		header.key = key;
+		header.format = format;
+		header.length = (uint32_t)length;
+
+		string tempPath = path + ".tmp";
+		{
+			ofstream out(tempPath.c_str(), ios::binary | ios::trunc);
+			if (!out) {
+				cout << "WARNING::PROGRAMBINARYCACHE:: could not create " << tempPath << endl;
+				return false;
+			}
+			out.write((const char*)&header, sizeof(header));
+			out.write(binary.data(), header.length);
+			if (!out) {
+				out.close();
+				remove(tempPath.c_str());
+				return false;
+			}
+		}
+		remove(path.c_str());
+		if (rename(tempPath.c_str(), path.c_str()) != 0) {
+			remove(tempPath.c_str());
+			return false;
+		}
+		stored++;
+		return true;
+	}
+
+	void PrintStats() const {
+		if (!supported) {
+			cout << "Program binaries: not supported by the driver, every program compiled from source" << endl;
+			return;
+		}
+		cout << "Program binaries: " << loaded << " loaded, " << stored << " stored, " << rebuilt << " rebuilt" << endl;
+	}
+
+private:
+	static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+
+	bool         checked;
+	bool         supported;
+	uint64_t     driverHash;
+	unsigned int loaded;
+	unsigned int stored;
+	unsigned int rebuilt; // stale or rejected
+
+	// FNV-1a of 'text' and its length, continuing from 'seed'
+	static uint64_t hash(const string &text, uint64_t seed) {
+		uint64_t h = seed;
+		for (size_t i = 0; i < text.size(); i++)
+			h = (h ^ (unsigned char)text[i]) * 1099511628211ULL;
+		uint64_t length = text.size();
+		for (int i = 0; i < 8; i++)
+			h = (h ^ ((length >> (i * 8)) & 0xFF)) * 1099511628211ULL;
+		return h;
+	}
+
+	static string glString(GLenum name) {
+		const GLubyte *value = glGetString(name);
+		return value != NULL ? string((const char*)value) : string();
+	}
+};
+
+#endif
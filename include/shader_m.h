@@ -3,101 +3,397 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
+#include <loadprofiler.h>
+#include <programbinarycache.h>
+#include <uniformblocks.h>
+#include <virtualfile.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <set>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+
+// Handle of a uniform of one program, looked up once with Shader::Uniform and passed to the
+// setters instead of the name. Invalid (-1) for a name the program does not have.
+struct UniformHandle
+{
+    int index;
+
+    UniformHandle() : index(-1) {}
+    explicit UniformHandle(int index) : index(index) {}
+
+    bool IsValid() const { return index >= 0; }
+};
+
+// glUniform* calls the setters made, and the ones they skipped because the value was already set
+struct UniformStats
+{
+    unsigned long long issued;  // this frame so far
+    unsigned long long skipped;
+    unsigned long long frameIssued; // over the last complete frame
+    unsigned long long frameSkipped;
+
+    UniformStats() : issued(0), skipped(0), frameIssued(0), frameSkipped(0) {}
+
+    void EndFrame()
+    {
+        frameIssued = issued;
+        frameSkipped = skipped;
+        issued = skipped = 0;
+    }
+
+    void Print() const
+    {
+        std::cout << "Uniforms: " << frameIssued << " updates issued, " << frameSkipped << " skipped (value unchanged) per frame" << std::endl;
+    }
+};
+
+// Active uniforms of a linked program, enumerated once with glGetActiveUniform into an open
+// addressing table keyed by name. Arrays are entered by their name, "name[0]" and every
+// "name[i]", all pointing into one uniform. Next to each uniform is a copy of the last value
+// sent to it: a set with the same bytes is skipped, uniforms keep their value in the program.
+class ShaderUniforms
+{
+public:
+    void Build(GLuint program)
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> name((size_t)std::max(maxLength, 1) + 16);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLint size;
+            GLenum type;
+            glGetActiveUniform(program, (GLuint)i, (GLsizei)name.size(), NULL, &size, &type, name.data());
+            GLint location = glGetUniformLocation(program, name.data());
+            if (location < 0) continue; // members of uniform blocks
+
+            Uniform uniform;
+            uniform.elementBytes = typeBytes(type);
+            uniform.elements = (unsigned int)size;
+            uniform.firstElement = (unsigned int)known.size();
+            uniform.valueOffset = values.size();
+            values.resize(values.size() + uniform.elementBytes * uniform.elements);
+            known.resize(known.size() + uniform.elements, 0);
+            unsigned int index = (unsigned int)uniforms.size();
+            uniforms.push_back(uniform);
+
+            std::string fullName(name.data());
+            addEntry(fullName, location, index, 0);
+            size_t bracket = fullName.size() > 3 ? fullName.rfind("[0]") : std::string::npos;
+            if (bracket != std::string::npos && bracket + 3 == fullName.size())
+            {
+                std::string base = fullName.substr(0, bracket);
+                addEntry(base, location, index, 0);
+                for (GLint e = 1; e < size; e++)
+                {
+                    std::string element = base + "[" + std::to_string(e) + "]";
+                    addEntry(element, glGetUniformLocation(program, element.c_str()), index, (unsigned int)e);
+                }
+            }
+        }
+
+        // at most half full
+        size_t slots = 16;
+        while (slots < entries.size() * 2)
+            slots *= 2;
+        table.assign(slots, -1);
+        for (unsigned int e = 0; e < entries.size(); e++)
+        {
+            size_t slot = hash(entries[e].name.c_str()) & (slots - 1);
+            while (table[slot] >= 0)
+                slot = (slot + 1) & (slots - 1);
+            table[slot] = (int)e;
+        }
+    }
+
+    // index of the entry of 'name', -1 if the program has no such active uniform
+    int Find(const char *name) const
+    {
+        if (table.empty()) return -1;
+        size_t mask = table.size() - 1;
+        for (size_t slot = hash(name) & mask; table[slot] >= 0; slot = (slot + 1) & mask)
+        {
+            if (strcmp(entries[table[slot]].name.c_str(), name) == 0)
+                return table[slot];
+        }
+        return -1;
+    }
+
+    // How many of the 'count' values of 'bytes' each starting at entry 'index' have to be sent:
+    // 0 when the program already holds them (or the entry is invalid), otherwise all of them that
+    // fit before the end of the array. The copy is updated and 'location' is where to send them.
+    GLsizei Changed(int index, const void *value, size_t bytes, GLsizei count, GLint &location)
+    {
+        if (index < 0) return 0;
+        const Entry &entry = entries[index];
+        const Uniform &uniform = uniforms[entry.uniform];
+        location = entry.location;
+        count = std::min(count, (GLsizei)(uniform.elements - entry.element));
+        if (count <= 0 || location < 0) return 0;
+
+        UniformStats &stats = Stats();
+        if (bytes > uniform.elementBytes)
+        {   // not the declared type, GL reports it; nothing to compare against
+            stats.issued++;
+            return count;
+        }
+        const unsigned char *src = (const unsigned char*)value;
+        bool same = true;
+        for (GLsizei c = 0; c < count && same; c++)
+        {
+            unsigned int element = entry.element + (unsigned int)c;
+            same = known[uniform.firstElement + element] != 0 &&
+                memcmp(&values[uniform.valueOffset + element * uniform.elementBytes], src + c * bytes, bytes) == 0;
+        }
+        if (same)
+        {
+            stats.skipped++;
+            return 0;
+        }
+        for (GLsizei c = 0; c < count; c++)
+        {
+            unsigned int element = entry.element + (unsigned int)c;
+            memcpy(&values[uniform.valueOffset + element * uniform.elementBytes], src + c * bytes, bytes);
+            known[uniform.firstElement + element] = 1;
+        }
+        stats.issued++;
+        return count;
+    }
+
+    static UniformStats& Stats()
+    {
+        static UniformStats stats;
+        return stats;
+    }
+
+private:
+    struct Uniform
+    {
+        size_t       valueOffset;  // of its value copy in 'values'
+        size_t       elementBytes;
+        unsigned int elements;     // array size, 1 otherwise
+        unsigned int firstElement; // in 'known'
+    };
+
+    struct Entry
+    {
+        std::string  name;
+        GLint        location;
+        unsigned int uniform;
+        unsigned int element;
+    };
+
+    std::vector<Uniform>       uniforms;
+    std::vector<Entry>         entries;
+    std::vector<int>           table;  // entry per slot, -1 when empty
+    std::vector<unsigned char> values;
+    std::vector<unsigned char> known;  // per element: whether 'values' holds what was sent
+
+    void addEntry(const std::string &name, GLint location, unsigned int uniform, unsigned int element)
+    {
+        Entry entry;
+        entry.name = name;
+        entry.location = location;
+        entry.uniform = uniform;
+        entry.element = element;
+        entries.push_back(entry);
+    }
+
+    static size_t hash(const char *name)
+    {
+        uint32_t h = 2166136261u; // FNV-1a
+        for (; *name; name++)
+            h = (h ^ (unsigned char)*name) * 16777619u;
+        return h;
+    }
+
+    static size_t typeBytes(GLenum type)
+    {
+        switch (type)
+        {
+        case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_UNSIGNED_INT_VEC2: case GL_BOOL_VEC2: return 8;
+        case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_UNSIGNED_INT_VEC3: case GL_BOOL_VEC3: return 12;
+        case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_UNSIGNED_INT_VEC4: case GL_BOOL_VEC4: case GL_FLOAT_MAT2: return 16;
+        case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT3x2: return 24;
+        case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT4x2: return 32;
+        case GL_FLOAT_MAT3: return 36;
+        case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x3: return 48;
+        case GL_FLOAT_MAT4: return 64;
+        default: return 4; // scalars and samplers
+        }
+    }
+};
+
+// Programs compiled, at startup and once frames are being drawn. A compile and link in the
+// render loop stalls the frame it happens in, and a program built per frame does it every
+// frame: each program compiled after the first frame is reported once, with what it cost, and
+// Print() shows whether the count keeps growing.
+class ShaderCompileStats
+{
+public:
+    unsigned int startupCompiles;
+    unsigned int frameCompiles;  // after the first frame
+    double       frameCompileMs;
+    unsigned int frames;
+
+    ShaderCompileStats() : startupCompiles(0), frameCompiles(0), frameCompileMs(0.0), frames(0) {}
+
+    void Compiled(const std::string &name, double ms)
+    {
+        if (frames == 0)
+        {
+            startupCompiles++;
+            return;
+        }
+        frameCompiles++;
+        frameCompileMs += ms;
+        if (reported.insert(name).second)
+            std::cout << "WARNING::SHADER::COMPILED_DURING_FRAME " << frames << ": " << name << " (" << ms << " ms)" << std::endl;
+    }
+
+    void EndFrame()
+    {
+        frames++;
+    }
+
+    void Print() const
+    {
+        std::cout << "Shader compiles: " << startupCompiles << " at startup, " << frameCompiles << " during frames ("
+                  << frameCompileMs << " ms)" << std::endl;
+    }
+
+private:
+    std::set<std::string> reported;
+};
 
 class Shader
 {
 public:
     unsigned int ID;
 	GLuint m_boneLocation[100];
+	unsigned int attributeMask; // bit per location of the active vertex inputs, see Mesh::Draw
+	std::shared_ptr<ShaderUniforms> uniforms; // shared by the copies of the shader (the models take it by value)
 
-    // constructor generates the shader on the fly
+    // constructor generates the shader on the fly. 'defines' ("#define" lines) are added to
+    // every stage, after its #version line. With a 'binaries' cache the program is linked from
+    // the binary saved by an earlier run when it is still valid, and saved after building it
+    // otherwise. Programs should come from the ShaderRegistry, which builds each one once.
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const std::string &defines = std::string(),
+           ProgramBinaryCache *binaries = nullptr)
     {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        // profiled under "vertex + fragment"
+        std::string profileName = std::string(vertexPath) + " + " + fragmentPath;
+        LoadTimer readTimer(profileName, "shader", "read");
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
         std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
-            // if geometry shader path is present, also load a geometry shader
-            if(geometryPath != nullptr)
-            {
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
-        }
-        catch (std::ifstream::failure& e)
+        // through the VirtualFileSystem, so the asset pack can provide them
+        const VirtualFileSystem &files = VirtualFileSystem::Get();
+        if (!files.ReadText(vertexPath, vertexCode) || !files.ReadText(fragmentPath, fragmentCode) ||
+            (geometryPath != nullptr && !files.ReadText(geometryPath, geometryCode)))
         {
-			e;
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
+        readTimer.Stop();
+        LoadProfiler::Get().AddBytesRead(profileName, "shader", vertexCode.size() + fragmentCode.size() + geometryCode.size());
+        if (!defines.empty())
         {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
+            vertexCode = withDefines(vertexCode, defines);
+            fragmentCode = withDefines(fragmentCode, defines);
+            if (geometryPath != nullptr)
+                geometryCode = withDefines(geometryCode, defines);
         }
-        // shader Program
+        // a binary from an earlier run, when it was built from these sources by this driver
+        if (binaries != nullptr && !binaries->Supported())
+            binaries = nullptr;
+        std::string binaryPath;
+        uint64_t binaryKey = 0;
+        bool fromBinary = false;
         ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        if (binaries != nullptr)
+        {
+            LoadTimer binaryTimer(profileName, "shader", "binary");
+            binaryPath = ProgramBinaryCache::Path(vertexPath, fragmentPath, geometryPath != nullptr ? geometryPath : "", defines);
+            binaryKey = binaries->Key(vertexCode, fragmentCode, geometryCode);
+            fromBinary = binaries->Load(ID, binaryPath, binaryKey);
+            if (!fromBinary)
+            {
+                // start over with a program the failed binary left nothing in
+                glDeleteProgram(ID);
+                ID = glCreateProgram();
+            }
+        }
+        if (!fromBinary)
+        {
+            LoadTimer compileTimer(profileName, "shader", "compile");
+            const char* vShaderCode = vertexCode.c_str();
+            const char * fShaderCode = fragmentCode.c_str();
+            // 2. compile shaders
+            unsigned int vertex, fragment;
+            // vertex shader
+            vertex = glCreateShader(GL_VERTEX_SHADER);
+            glShaderSource(vertex, 1, &vShaderCode, NULL);
+            glCompileShader(vertex);
+            checkCompileErrors(vertex, "VERTEX");
+            // fragment Shader
+            fragment = glCreateShader(GL_FRAGMENT_SHADER);
+            glShaderSource(fragment, 1, &fShaderCode, NULL);
+            glCompileShader(fragment);
+            checkCompileErrors(fragment, "FRAGMENT");
+            // if geometry shader is given, compile geometry shader
+            unsigned int geometry;
+            if(geometryPath != nullptr)
+            {
+                const char * gShaderCode = geometryCode.c_str();
+                geometry = glCreateShader(GL_GEOMETRY_SHADER);
+                glShaderSource(geometry, 1, &gShaderCode, NULL);
+                glCompileShader(geometry);
+                checkCompileErrors(geometry, "GEOMETRY");
+            }
+            // shader Program
+            glAttachShader(ID, vertex);
+            glAttachShader(ID, fragment);
+            if(geometryPath != nullptr)
+                glAttachShader(ID, geometry);
+            if (binaries != nullptr)
+                binaries->Retrievable(ID);
+            glLinkProgram(ID);
+            checkCompileErrors(ID, "PROGRAM");
+            // delete the shaders as they're linked into our program now and no longer necessery
+            glDetachShader(ID, vertex);
+            glDetachShader(ID, fragment);
+            glDeleteShader(vertex);
+            glDeleteShader(fragment);
+            if(geometryPath != nullptr)
+            {
+                glDetachShader(ID, geometry);
+                glDeleteShader(geometry);
+            }
+            GLint linked = 0;
+            glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+            if (binaries != nullptr && linked)
+                binaries->Store(ID, binaryPath, binaryKey);
+        }
+        attributeMask = queryAttributeMask();
+        // FrameData and LightData come from the shared buffers, not from this program
+        BindUniformBlocks(ID);
+        uniforms = std::make_shared<ShaderUniforms>();
+        uniforms->Build(ID);
+        CompileStats().Compiled(profileName, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -105,68 +401,127 @@ public:
     { 
         glUseProgram(ID); 
     }
-    // utility uniform functions
+    // handle of a uniform, to look it up once instead of at every set. An invalid handle
+    // (a name the program does not have, or that the linker dropped) makes the setters do nothing.
+    // ------------------------------------------------------------------------
+    UniformHandle Uniform(const std::string &name) const
+    {
+        return UniformHandle(uniforms->Find(name.c_str()));
+    }
+    // utility uniform functions. They skip the glUniform call when the program already has
+    // the value (see ShaderUniforms), and count both cases in Stats().
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        setInt(Uniform(name), (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        setInt(Uniform(name), value);
+    }
+    void setInt(UniformHandle uniform, int value) const
+    {
+        GLint location;
+        if (uniforms->Changed(uniform.index, &value, sizeof(value), 1, location))
+            glUniform1i(location, value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        setFloat(Uniform(name), value);
+    }
+    void setFloat(UniformHandle uniform, float value) const
+    {
+        GLint location;
+        if (uniforms->Changed(uniform.index, &value, sizeof(value), 1, location))
+            glUniform1f(location, value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setVec2(Uniform(name), value);
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        setVec2(Uniform(name), glm::vec2(x, y));
+    }
+    void setVec2(UniformHandle uniform, const glm::vec2 &value) const
+    {
+        GLint location;
+        if (uniforms->Changed(uniform.index, &value[0], sizeof(value), 1, location))
+            glUniform2fv(location, 1, &value[0]);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setVec3(Uniform(name), value);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        setVec3(Uniform(name), glm::vec3(x, y, z));
+    }
+    void setVec3(UniformHandle uniform, const glm::vec3 &value) const
+    {
+        GLint location;
+        if (uniforms->Changed(uniform.index, &value[0], sizeof(value), 1, location))
+            glUniform3fv(location, 1, &value[0]);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setVec4(Uniform(name), value);
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        setVec4(Uniform(name), glm::vec4(x, y, z, w));
+    }
+    void setVec4(UniformHandle uniform, const glm::vec4 &value) const
+    {
+        GLint location;
+        if (uniforms->Changed(uniform.index, &value[0], sizeof(value), 1, location))
+            glUniform4fv(location, 1, &value[0]);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        GLint location;
+        if (uniforms->Changed(Uniform(name).index, &mat[0][0], sizeof(mat), 1, location))
+            glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat3(Uniform(name), mat);
+    }
+    void setMat3(UniformHandle uniform, const glm::mat3 &mat) const
+    {
+        GLint location;
+        if (uniforms->Changed(uniform.index, &mat[0][0], sizeof(mat), 1, location))
+            glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat4(Uniform(name), mat);
+    }
+    void setMat4(UniformHandle uniform, const glm::mat4 &mat) const
+    {
+        setMat4(uniform, 1, &mat);
     }
 
 	void setMat4(const std::string &name,const int i, const glm::mat4 *mat) const
 	{
-		glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), i, GL_FALSE, &mat[0][0][0]); //
+		setMat4(Uniform(name), i, mat);
+	}
+
+	// 'count' matrices from the element the handle names (the first one for the array name)
+	void setMat4(UniformHandle uniform, int count, const glm::mat4 *mat) const
+	{
+		GLint location;
+		GLsizei sent = uniforms->Changed(uniform.index, &mat[0][0][0], sizeof(glm::mat4), (GLsizei)count, location);
+		if (sent > 0)
+			glUniformMatrix4fv(location, sent, GL_FALSE, &mat[0][0][0]);
 	}
 
 	void setBonesIDs(unsigned int max_bones) {
@@ -184,13 +539,61 @@ public:
 		char Name[16];
 		memset(Name, 0, sizeof(Name));
 		sprintf_s(Name, "gBones[%d]", Index);
-		GLint location = glGetUniformLocation(ID, Name);
-		glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(mat));
+		setMat4(Uniform(Name), mat);
 	}
 
+    // uniform updates of every program, per frame
+    static UniformStats& Stats()
+    {
+        return ShaderUniforms::Stats();
+    }
+    // programs compiled before and during the frames
+    static ShaderCompileStats& CompileStats()
+    {
+        static ShaderCompileStats stats;
+        return stats;
+    }
+
 private:
+    // 'code' with 'defines' inserted after its #version line, which has to stay the first one
+    static std::string withDefines(const std::string &code, const std::string &defines)
+    {
+        size_t version = code.find("#version");
+        if (version == std::string::npos)
+            return defines + code;
+        size_t lineEnd = code.find('\n', version);
+        if (lineEnd == std::string::npos)
+            return code + "\n" + defines;
+        return code.substr(0, lineEnd + 1) + defines + code.substr(lineEnd + 1);
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
+    // Locations of the vertex inputs the linker kept: the ones the shader declares but never
+    // reads (tangents in most of ours) are not active and are left out
+    unsigned int queryAttributeMask()
+    {
+        GLint count = 0;
+        glGetProgramiv(ID, GL_ACTIVE_ATTRIBUTES, &count);
+        unsigned int mask = 0;
+        for (GLint i = 0; i < count; i++)
+        {
+            GLchar name[128];
+            GLint size;
+            GLenum type;
+            glGetActiveAttrib(ID, (GLuint)i, sizeof(name), NULL, &size, &type, name);
+            GLint location = glGetAttribLocation(ID, name);
+            if (location < 0 || location >= 32) continue; // built-ins such as gl_VertexID
+            // matrices take one location per column
+            int columns = (type == GL_FLOAT_MAT4 || type == GL_FLOAT_MAT4x2 || type == GL_FLOAT_MAT4x3) ? 4 :
+                          (type == GL_FLOAT_MAT3 || type == GL_FLOAT_MAT3x2 || type == GL_FLOAT_MAT3x4) ? 3 :
+                          (type == GL_FLOAT_MAT2 || type == GL_FLOAT_MAT2x3 || type == GL_FLOAT_MAT2x4) ? 2 : 1;
+            for (int l = 0; l < size * columns && location + l < 32; l++)
+                mask |= 1u << (location + l);
+        }
+        return mask;
+    }
+
     void checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
@@ -0,0 +1,122 @@
+#ifndef SHADERREGISTRY_H
+#define SHADERREGISTRY_H
+
+#include <glad/glad.h>
+
+#include <assetpack.h>
+#include <programbinarycache.h>
+#include <shader_m.h>
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+// What tells programs apart: the source file of each stage and the defines added to them
+struct ShaderProgramDesc
+{
+	string         vertexPath;
+	string         fragmentPath;
+	string         geometryPath; // empty without a geometry stage
+	vector<string> defines;      // "NAME" or "NAME VALUE"
+
+	ShaderProgramDesc() {}
+	ShaderProgramDesc(const string &vertexPath, const string &fragmentPath, const string &geometryPath = string())
+		: vertexPath(vertexPath), fragmentPath(fragmentPath), geometryPath(geometryPath) {}
+
+	ShaderProgramDesc& Define(const string &define) {
+		defines.push_back(define);
+		return *this;
+	}
+
+	// paths in the form of the asset pack keys, so "shaders/11_fresnel.vs" and
+	// "shaders\11_Fresnel.vs" are the same program
+	string Key() const {
+		string key = "vs:" + PackPathKey(vertexPath) + "|fs:" + PackPathKey(fragmentPath);
+		if (!geometryPath.empty())
+			key += "|gs:" + PackPathKey(geometryPath);
+		for (size_t i = 0; i < defines.size(); i++)
+			key += "|" + defines[i];
+		return key;
+	}
+
+	// the defines as the lines added to every stage
+	string DefineLines() const {
+		string lines;
+		for (size_t i = 0; i < defines.size(); i++)
+			lines += "#define " + defines[i] + "\n";
+		return lines;
+	}
+};
+
+// Process-wide owner of the shader programs. Acquire() compiles and links a program the first
+// time its description is asked for and hands out the same Shader afterwards, so every user of
+// a program shares one GL object and nothing is compiled in the render loop once the programs
+// are loaded. Linked programs are kept on disk by a ProgramBinaryCache, so later runs skip the
+// GLSL compile when the sources and the driver did not change. The registry deletes the
+// programs: Collect() the ones nobody holds any more, Clear() all of them at shutdown. GL
+// thread only.
+class ShaderRegistry
+{
+public:
+	static ShaderRegistry& Get() {
+		static ShaderRegistry instance;
+		return instance;
+	}
+
+	shared_ptr<Shader> Acquire(const ShaderProgramDesc &desc) {
+		string key = desc.Key();
+		map<string, shared_ptr<Shader> >::iterator it = programs.find(key);
+		if (it != programs.end()) {
+			hits++;
+			return it->second;
+		}
+		shared_ptr<Shader> shader = make_shared<Shader>(desc.vertexPath.c_str(), desc.fragmentPath.c_str(),
+			desc.geometryPath.empty() ? nullptr : desc.geometryPath.c_str(), desc.DefineLines(), &binaries);
+		programs[key] = shader;
+		return shader;
+	}
+
+	shared_ptr<Shader> Acquire(const string &vertexPath, const string &fragmentPath) {
+		return Acquire(ShaderProgramDesc(vertexPath, fragmentPath));
+	}
+
+	// deletes the programs only the registry still holds
+	void Collect() {
+		map<string, shared_ptr<Shader> >::iterator it = programs.begin();
+		while (it != programs.end()) {
+			if (it->second.use_count() == 1) {
+				glDeleteProgram(it->second->ID);
+				it = programs.erase(it);
+			}
+			else
+				++it;
+		}
+	}
+
+	// deletes every program, while the context is still alive. Shaders still held elsewhere are
+	// left without a program.
+	void Clear() {
+		for (map<string, shared_ptr<Shader> >::iterator it = programs.begin(); it != programs.end(); ++it)
+			glDeleteProgram(it->second->ID);
+		programs.clear();
+	}
+
+	void PrintStats() const {
+		cout << "Shader registry: " << programs.size() << " programs, " << hits << " shared" << endl;
+		binaries.PrintStats();
+	}
+
+private:
+	map<string, shared_ptr<Shader> > programs; // by ShaderProgramDesc::Key
+	unsigned int                     hits;
+	ProgramBinaryCache               binaries;
+
+	ShaderRegistry() : hits(0) {}
+	ShaderRegistry(const ShaderRegistry&);
+	ShaderRegistry& operator=(const ShaderRegistry&);
+};
+
+#endif
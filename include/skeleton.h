@@ -0,0 +1,164 @@
+#ifndef SKELETON_H
+#define SKELETON_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <modelstructs.h>
+
+#include <iostream>
+#include <math.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Node of the imported hierarchy. Nodes are stored depth first, so a parent always comes before
+// its children and the whole hierarchy can be walked with a single loop.
+struct SkeletonNode
+{
+	string name;
+	int    parent; // -1 for the root
+};
+
+struct VectorKey
+{
+	float     time;
+	glm::vec3 value;
+};
+
+struct QuatKey
+{
+	float     time;
+	glm::quat value;
+};
+
+// Keys of one animated node
+struct AnimationChannel
+{
+	vector<VectorKey> positions;
+	vector<QuatKey>   rotations;
+	vector<VectorKey> scalings;
+};
+
+struct AnimationClip
+{
+	string                   name;
+	float                    duration;       // in ticks
+	float                    ticksPerSecond;
+	vector<int>              nodeChannels;   // channel of every node, -1 when the node is not animated
+	vector<AnimationChannel> channels;
+};
+
+// Skeleton and animation clips owned by a model, so the Assimp scene can be freed right after
+// the import. Evaluate() reproduces what the old recursive walk over the aiNode tree computed.
+class Skeleton
+{
+public:
+	vector<SkeletonNode>  nodes;
+	vector<AnimationClip> clips;
+
+	bool Empty() const { return nodes.empty(); }
+
+	// Links every bone to the node with the same name (the last one in depth-first order wins,
+	// like the old walk that overwrote the bone at every match). Needed after the bones change.
+	void BindBones(const vector<Bone> &bones) {
+		boneNodes.assign(bones.size(), -1);
+		for (unsigned int n = 0; n < nodes.size(); n++)
+			for (unsigned int b = 0; b < bones.size(); b++)
+				if (nodes[n].name == bones[b].name.C_Str())
+					boneNodes[b] = (int)n;
+	}
+
+	// Global transform of every node at the given time (in ticks) of a clip, false if there is no
+	// such clip. 'globals' is kept by the caller to avoid an allocation per frame.
+	bool EvaluateNodes(unsigned int clipIndex, float time, vector<glm::mat4> &globals) const {
+		if (clipIndex >= clips.size()) return false;
+		const AnimationClip &clip = clips[clipIndex];
+
+		globals.resize(nodes.size());
+		for (unsigned int n = 0; n < nodes.size(); n++) {
+			// nodes without a channel contribute an identity transform, not their bind transform
+			glm::mat4 local(1.0f);
+			int channel = clip.nodeChannels[n];
+			if (channel >= 0)
+				local = channelTransform(clip.channels[channel], time);
+			globals[n] = nodes[n].parent >= 0 ? globals[nodes[n].parent] * local : local;
+		}
+		return true;
+	}
+
+	// node driving a bone, -1 when there is none
+	int BoneNode(unsigned int bone) const {
+		return bone < boneNodes.size() ? boneNodes[bone] : -1;
+	}
+
+	// Poses the bones at the given time of a clip, see EvaluateNodes
+	void Evaluate(unsigned int clipIndex, float time, const glm::mat4 &globalInverseTransform, vector<Bone> &bones, vector<glm::mat4> &globals) const {
+		if (!EvaluateNodes(clipIndex, time, globals)) return;
+
+		for (unsigned int b = 0; b < bones.size(); b++)
+			if (BoneNode(b) >= 0)
+				bones[b].transformation = globalInverseTransform * globals[BoneNode(b)] * bones[b].offsetMatrix;
+	}
+
+	// bytes held by the hierarchy and the keys
+	size_t MemorySize() const {
+		size_t size = nodes.size() * sizeof(SkeletonNode) + boneNodes.size() * sizeof(int);
+		for (unsigned int c = 0; c < clips.size(); c++) {
+			size += clips[c].nodeChannels.size() * sizeof(int);
+			for (unsigned int i = 0; i < clips[c].channels.size(); i++) {
+				const AnimationChannel &channel = clips[c].channels[i];
+				size += (channel.positions.size() + channel.scalings.size()) * sizeof(VectorKey) + channel.rotations.size() * sizeof(QuatKey);
+			}
+		}
+		return size;
+	}
+
+private:
+	vector<int> boneNodes; // node of every bone, -1 when there is none
+
+	// Index of the key before 'time'. Past the last key the first one is used, as Assimp's
+	// sample code did.
+	template <class Key>
+	static unsigned int findKey(const vector<Key> &keys, float time) {
+		for (unsigned int i = 0; i + 1 < keys.size(); i++)
+			if (time < keys[i + 1].time)
+				return i;
+		return 0;
+	}
+
+	template <class Key>
+	static float keyFactor(const vector<Key> &keys, unsigned int index, float time) {
+		return (time - keys[index].time) / (keys[index + 1].time - keys[index].time);
+	}
+
+	static glm::vec3 interpolate(const vector<VectorKey> &keys, float time) {
+		if (keys.size() == 1) return keys[0].value;
+		unsigned int index = findKey(keys, time);
+		float factor = keyFactor(keys, index, time);
+		return keys[index].value + factor * (keys[index + 1].value - keys[index].value);
+	}
+
+	static glm::quat interpolate(const vector<QuatKey> &keys, float time) {
+		if (keys.size() == 1) return keys[0].value;
+		unsigned int index = findKey(keys, time);
+		float factor = keyFactor(keys, index, time);
+		return glm::normalize(glm::slerp(keys[index].value, keys[index + 1].value, factor));
+	}
+
+	static glm::mat4 channelTransform(const AnimationChannel &channel, float time) {
+		glm::vec3 scaling = channel.scalings.empty() ? glm::vec3(1.0f) : interpolate(channel.scalings, time);
+		glm::quat rotation = channel.rotations.empty() ? glm::quat(1.0f, 0.0f, 0.0f, 0.0f) : interpolate(channel.rotations, time);
+		glm::vec3 translation = channel.positions.empty() ? glm::vec3(0.0f) : interpolate(channel.positions, time);
+
+		glm::mat4 S = glm::scale(glm::mat4(1.0f), scaling);
+		glm::mat4 R = glm::mat4_cast(rotation);
+		// the translation was only applied when the scaling matrix passed aiMatrix4x4::IsIdentity()
+		const float epsilon = 10e-3f;
+		bool unitScale = fabsf(scaling.x - 1.0f) <= epsilon && fabsf(scaling.y - 1.0f) <= epsilon && fabsf(scaling.z - 1.0f) <= epsilon;
+		glm::mat4 T = unitScale ? glm::translate(glm::mat4(1.0f), translation) : glm::mat4(1.0f);
+		return T * R * S;
+	}
+};
+
+#endif
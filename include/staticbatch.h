@@ -0,0 +1,177 @@
+#ifndef STATICBATCH_H
+#define STATICBATCH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <mesh.h>
+#include <meshlet.h>
+#include <meshlod.h>
+#include <modelgeometry.h>
+#include <shader.h>
+#include <texturecache.h>
+#include <vertexlayout.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Static scenery
+// --------------
+// Objects that never move do not need a model matrix of their own. Add() copies the meshes of
+// one such object with its transform baked into the vertices (bounds, levels of detail and
+// meshlets moved with them), and Build() merges everything added into a ModelGeometry, so the
+// meshes of all the objects that share a material become a single draw call. The whole batch
+// is drawn with an identity "model" matrix, sent once.
+class StaticBatch
+{
+public:
+	StaticBatch() : objects(0) {}
+
+	// gives back the textures the copies kept alive
+	~StaticBatch() {
+		for (unsigned int i = 0; i < retainedTextures.size(); i++)
+			TextureCache::Get().Release(retainedTextures[i]);
+	}
+
+	// Adds an object placed with 'transform' that stays there: world space copies of its uploaded
+	// 'meshes'. The textures are retained, so the model can be deleted afterwards. Context thread
+	// only, before Build().
+	void Add(const vector<Mesh> &source, const glm::mat4 &transform) {
+		glm::mat3 linear(transform);
+		bool mirrored = glm::determinant(linear) < 0.0f;
+		float scaleX = glm::length(linear[0]), scaleY = glm::length(linear[1]), scaleZ = glm::length(linear[2]);
+		float scale = max(scaleX, max(scaleY, scaleZ));
+		bool uniform = scale - min(scaleX, min(scaleY, scaleZ)) <= scale * 0.001f;
+
+		objects++;
+		vector<unsigned char> packed;
+		vector<unsigned int> indices;
+		for (unsigned int m = 0; m < source.size(); m++) {
+			const Mesh &mesh = source[m];
+			if (!mesh.IsUploaded()) {
+				cout << "WARNING::STATICBATCH:: mesh without buffers of its own (not uploaded or merged), skipped" << endl;
+				continue;
+			}
+			if (mesh.vertexCount == 0 || mesh.indexCount == 0) continue;
+
+			// the CPU copy when the mesh kept one, the GL buffers otherwise (meshes from the cache)
+			if (!mesh.vertices.empty())
+				mesh.PackVertices(packed);
+			else {
+				packed.resize(mesh.VertexBytes());
+				glBindBuffer(GL_COPY_READ_BUFFER, mesh.VertexBuffer());
+				glGetBufferSubData(GL_COPY_READ_BUFFER, 0, packed.size(), packed.data());
+			}
+			if (!mesh.indices.empty())
+				indices = mesh.indices;
+			else
+				readIndices(mesh, indices);
+			glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+			mesh.layout.Transform(packed.data(), mesh.vertexCount, transform);
+			if (mirrored) {
+				for (size_t i = 0; i + 2 < indices.size(); i += 3)
+					swap(indices[i + 1], indices[i + 2]);
+			}
+
+			// bounds of the moved positions
+			const unsigned char *positions = packed.data() + mesh.layout.StreamOffset(STREAM_POSITION, mesh.vertexCount);
+			glm::vec3 boundsMin, boundsMax;
+			for (unsigned int i = 0; i < mesh.vertexCount; i++) {
+				glm::vec3 p;
+				memcpy(&p, positions + (size_t)i * mesh.layout.streamStrides[STREAM_POSITION], 12);
+				boundsMin = i == 0 ? p : glm::min(boundsMin, p);
+				boundsMax = i == 0 ? p : glm::max(boundsMax, p);
+			}
+
+			vector<MeshLod> lods = mesh.lods;
+			for (unsigned int i = 0; i < lods.size(); i++)
+				lods[i].error *= scale;
+
+			// the cone angle only survives a uniform scale
+			vector<Meshlet> meshlets = mesh.meshlets;
+			for (unsigned int i = 0; i < meshlets.size(); i++) {
+				Meshlet &meshlet = meshlets[i];
+				meshlet.center = glm::vec3(transform * glm::vec4(meshlet.center, 1.0f));
+				meshlet.radius *= scale;
+				if (meshlet.coneCutoff > 1.0f) continue;
+				if (uniform) {
+					meshlet.coneApex = glm::vec3(transform * glm::vec4(meshlet.coneApex, 1.0f));
+					meshlet.coneAxis = glm::normalize(linear * meshlet.coneAxis);
+				}
+				else
+					meshlet.coneCutoff = 2.0f;
+			}
+
+			for (unsigned int t = 0; t < mesh.textures.size(); t++) {
+				TextureCache::Get().Retain(mesh.textures[t].id);
+				retainedTextures.push_back(mesh.textures[t].id);
+			}
+			meshes.push_back(Mesh(packed.data(), mesh.vertexCount, mesh.layout, indices.data(), (unsigned int)indices.size(), mesh.textures,
+				boundsMin, boundsMax, std::move(lods), std::move(meshlets)));
+		}
+	}
+
+	// merges everything added so far by material, the copies give their own buffers back
+	void Build(const string &name) {
+		geometry.Build(meshes);
+		if (!geometry.IsBuilt()) return;
+		for (unsigned int i = 0; i < meshes.size(); i++)
+			meshes[i].ReleaseBuffers();
+		cout << "Static: " << name << ": " << objects << " objects baked into world space" << endl;
+		geometry.Print(name, meshes.size());
+	}
+
+	// CPU and GPU bytes of the batch: the copies keep their levels and meshlets, the geometry the buffers
+	GeometryMemory Memory() const {
+		GeometryMemory memory;
+		for (unsigned int i = 0; i < meshes.size(); i++)
+			memory.Add(meshes[i].Memory());
+		memory.gpuBytes += geometry.GpuBytes();
+		return memory;
+	}
+
+	// sets "model" to the identity and draws the batch, every mesh at the level of detail 'view'
+	// picks for it; with 'cull' only the meshes and meshlets the camera can see
+	void Draw(Shader &shader, const LodView &view, const CullView *cull = nullptr) {
+		if (!geometry.IsBuilt()) return;
+		const glm::mat4 identity(1.0f);
+		shader.setMat4("model", identity);
+		view.SelectAll(meshes, identity, lodLevels);
+		if (cull != nullptr) {
+			MeshletCuller culler(*cull, identity);
+			geometry.Draw(shader, meshes, nullptr, &lodLevels, &culler);
+		}
+		else
+			geometry.Draw(shader, meshes, nullptr, &lodLevels);
+	}
+
+private:
+	vector<Mesh>         meshes; // world space, drawn from the geometry once built
+	ModelGeometry        geometry;
+	vector<unsigned int> lodLevels;        // level every mesh was drawn with last
+	vector<unsigned int> retainedTextures; // one reference per texture of every mesh
+	unsigned int         objects;
+
+	StaticBatch(const StaticBatch&);
+	StaticBatch& operator=(const StaticBatch&);
+
+	// the element buffer of 'mesh' read back as 32-bit indices
+	static void readIndices(const Mesh &mesh, vector<unsigned int> &indices) {
+		glBindBuffer(GL_COPY_READ_BUFFER, mesh.IndexBuffer());
+		if (mesh.indexType == GL_UNSIGNED_SHORT) {
+			vector<unsigned short> shortIndices(mesh.indexCount);
+			glGetBufferSubData(GL_COPY_READ_BUFFER, 0, mesh.IndexBytes(), shortIndices.data());
+			indices.assign(shortIndices.begin(), shortIndices.end());
+		}
+		else {
+			indices.resize(mesh.indexCount);
+			glGetBufferSubData(GL_COPY_READ_BUFFER, 0, mesh.IndexBytes(), indices.data());
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,296 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <glad/glad.h>
+
+#include <modelstructs.h>
+#include <loadprofiler.h>
+#include <textureredirects.h>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <stdint.h>
+using namespace std;
+
+// Normalized absolute form of a path, used as the identity of a file: forward slashes,
+// no "." or ".." components and, on Windows, lower case.
+inline string CanonicalPath(const string &path)
+{
+	string full = path;
+#ifdef _WIN32
+	char buffer[_MAX_PATH];
+	if (_fullpath(buffer, path.c_str(), _MAX_PATH) != nullptr)
+		full = buffer;
+#else
+	char *resolved = realpath(path.c_str(), nullptr);
+	if (resolved != nullptr) {
+		full = resolved;
+		free(resolved);
+	}
+#endif
+	// drop "." and resolve ".." for paths that could not be resolved by the OS
+	string canonical = NormalizePath(full);
+#ifdef _WIN32
+	transform(canonical.begin(), canonical.end(), canonical.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+#endif
+	return canonical;
+}
+
+// Process-wide cache of GL textures shared by every Model, AnimatedModel and CubeMap.
+// Textures are found by canonical path first and then by the hash of the file contents, so the
+// same image copied into several .fbm folders is decoded and uploaded only once. Handles are
+// reference counted: every Acquire must be paired with a Release of the returned id.
+class TextureCache
+{
+public:
+	struct Stats
+	{
+		unsigned int       hits;
+		unsigned int       misses;
+		unsigned long long bytesUploaded; // texel bytes sent to the GPU, mip levels included
+		unsigned long long bytesSaved;    // texel bytes that hits did not have to decode and upload
+
+		Stats() : hits(0), misses(0), bytesUploaded(0), bytesSaved(0) {}
+	};
+
+	static TextureCache& Get() {
+		static TextureCache instance;
+		return instance;
+	}
+
+	// 2D texture of an image file, decoded and uploaded on a miss. GL thread only.
+	unsigned int Acquire(const string &filename) {
+		string canonical = CanonicalPath(filename);
+		unsigned int id = find(canonical, 0);
+		if (id != 0) return id;
+
+		vector<unsigned char> bytes;
+		uint64_t hash = readFile(filename, bytes) && !bytes.empty() ? HashBytes(bytes.data(), bytes.size()) : 0;
+		id = find(canonical, hash);
+		if (id != 0) return id;
+
+		TextureImage image = DecodeTextureImage(filename, bytes);
+		return insert(UploadTextureImage(image), canonical, hash, GL_TEXTURE_2D, image.GPUSize());
+	}
+
+	// 2D texture of an image decoded on another thread (see Decode). GL thread only.
+	unsigned int Acquire(const TextureImage &image) {
+		string canonical = CanonicalPath(image.path);
+		unsigned int id = find(canonical, image.contentHash);
+		if (id != 0) return id;
+
+		// Decode skipped an image that was cached at the time but has been released since
+		if (!image.IsLoaded())
+			return Acquire(image.path);
+
+		return insert(UploadTextureImage(image), canonical, image.contentHash, GL_TEXTURE_2D, image.GPUSize());
+	}
+
+	// Decodes an image file on any thread, unless the cache already holds it: then only the
+	// path (and maybe the hash) are filled in and Acquire(image) resolves it to the cached texture.
+	TextureImage Decode(const string &filename) {
+		TextureImage image;
+		image.path = filename;
+		string canonical = CanonicalPath(filename);
+		if (contains(canonical, 0))
+			return image;
+
+		vector<unsigned char> bytes;
+		if (readFile(filename, bytes) && !bytes.empty())
+			image.contentHash = HashBytes(bytes.data(), bytes.size());
+		if (contains(canonical, image.contentHash))
+			return image;
+
+		return DecodeTextureImage(filename, bytes);
+	}
+
+	// Decodes a streamed image file on any thread, unless a texture with the same contents is
+	// already cached: then only the path and the hash are filled in, and the TextureStreamer
+	// redirects the placeholder of the request to that texture (see Redirect).
+	TextureImage DecodeStreamed(const string &filename) {
+		vector<unsigned char> bytes;
+		uint64_t hash = readFile(filename, bytes) && !bytes.empty() ? HashBytes(bytes.data(), bytes.size()) : 0;
+		if (contains(string(), hash)) {
+			TextureImage image;
+			image.path = filename;
+			image.contentHash = hash;
+			return image;
+		}
+		return DecodeTextureImage(filename, bytes);
+	}
+
+	// Lookup for other kinds of textures (e.g. cube maps): 'key' plays the role of the canonical
+	// path. Returns 0 on a miss, and the caller then creates the texture and calls Insert().
+	unsigned int Find(const string &key, uint64_t hash) {
+		return find(key, hash);
+	}
+
+	unsigned int Insert(unsigned int id, const string &key, uint64_t hash, GLenum target, unsigned long long bytes) {
+		return insert(id, key, hash, target, bytes);
+	}
+
+	// Records the contents of a texture inserted before they were known (see TextureStreamer)
+	void SetContent(unsigned int id, uint64_t hash, unsigned long long bytes) {
+		lock_guard<mutex> lock(cacheMutex);
+		map<unsigned int, Entry>::iterator it = entries.find(id);
+		if (it == entries.end()) return;
+		it->second.bytes = bytes;
+		stats.bytesUploaded += bytes;
+		if (hash != 0 && it->second.hash == 0 && byHash.count(hash) == 0) {
+			it->second.hash = hash;
+			byHash[hash] = id;
+		}
+	}
+
+	// Texture with the given contents, 0 when none is cached. No reference is taken.
+	unsigned int FindContent(uint64_t hash) {
+		lock_guard<mutex> lock(cacheMutex);
+		map<uint64_t, unsigned int>::iterator it = byHash.find(hash);
+		return (hash != 0 && it != byHash.end()) ? it->second : 0;
+	}
+
+	// Makes the texture 'from' (a streamed placeholder whose file turned out to hold the same
+	// image as 'to') an alias of 'to': its path and its references move over, and the id still
+	// stored in the materials resolves to 'to' through TextureRedirects. The placeholder name is
+	// deleted with 'to', so GL can not hand it out again while a material may still hold it.
+	// GL thread only.
+	void Redirect(unsigned int from, unsigned int to) {
+		lock_guard<mutex> lock(cacheMutex);
+		map<unsigned int, Entry>::iterator source = entries.find(from);
+		map<unsigned int, Entry>::iterator target = entries.find(to);
+		if (from == to || source == entries.end() || target == entries.end()) return;
+
+		target->second.refs += source->second.refs;
+		target->second.aliases.push_back(from);
+		byPath[source->second.key] = to;
+		target->second.aliasKeys.push_back(source->second.key);
+		entries.erase(source);
+		TextureRedirects::Get().Add(from, to);
+		stats.hits++;
+		stats.bytesSaved += target->second.bytes;
+	}
+
+	void Retain(unsigned int id) {
+		lock_guard<mutex> lock(cacheMutex);
+		id = resolve(id);
+		map<unsigned int, Entry>::iterator it = entries.find(id);
+		if (it != entries.end()) it->second.refs++;
+	}
+
+	// Drops a reference, the GL texture is deleted with the last one
+	void Release(unsigned int id) {
+		if (id == 0) return;
+		lock_guard<mutex> lock(cacheMutex);
+		id = resolve(id);
+		map<unsigned int, Entry>::iterator it = entries.find(id);
+		if (it == entries.end()) return;
+		if (--it->second.refs > 0) return;
+
+		byPath.erase(it->second.key);
+		if (it->second.hash != 0) byHash.erase(it->second.hash);
+		for (unsigned int i = 0; i < it->second.aliasKeys.size(); i++) {
+			map<string, unsigned int>::iterator alias = byPath.find(it->second.aliasKeys[i]);
+			if (alias != byPath.end() && alias->second == id) byPath.erase(alias);
+		}
+		for (unsigned int i = 0; i < it->second.aliases.size(); i++) {
+			TextureRedirects::Get().Remove(it->second.aliases[i]);
+			glDeleteTextures(1, &it->second.aliases[i]);
+		}
+		entries.erase(it);
+		glDeleteTextures(1, &id);
+	}
+
+	Stats GetStats() {
+		lock_guard<mutex> lock(cacheMutex);
+		return stats;
+	}
+
+	void PrintStats() {
+		Stats current = GetStats();
+		cout << "TextureCache: " << current.hits << " hits, " << current.misses << " misses, "
+			<< current.bytesUploaded / 1024 << " KB uploaded, " << current.bytesSaved / 1024 << " KB saved" << endl;
+	}
+
+private:
+	struct Entry
+	{
+		string               key;
+		uint64_t             hash;
+		GLenum               target;
+		unsigned long long   bytes;
+		unsigned int         refs;
+		vector<unsigned int> aliases;   // redirected placeholders (see Redirect)
+		vector<string>       aliasKeys; // and their paths
+	};
+
+	mutex                         cacheMutex;
+	map<unsigned int, Entry>      entries; // by GL id
+	map<string, unsigned int>     byPath;
+	map<uint64_t, unsigned int>   byHash;
+	Stats                         stats;
+
+	TextureCache() {}
+	TextureCache(const TextureCache&);
+	TextureCache& operator=(const TextureCache&);
+
+	// file contents, recorded in the load profile of the texture
+	static bool readFile(const string &filename, vector<unsigned char> &bytes) {
+		LoadTimer timer(filename, "texture", "read");
+		bool read = ReadFileBytes(filename, bytes);
+		LoadProfiler::Get().AddBytesRead(filename, "texture", bytes.size());
+		return read;
+	}
+
+	static unsigned int resolve(unsigned int id) {
+		return TextureRedirects::Get().Resolve(id);
+	}
+
+	bool contains(const string &key, uint64_t hash) {
+		lock_guard<mutex> lock(cacheMutex);
+		return byPath.count(key) > 0 || (hash != 0 && byHash.count(hash) > 0);
+	}
+
+	unsigned int find(const string &key, uint64_t hash) {
+		lock_guard<mutex> lock(cacheMutex);
+		map<string, unsigned int>::iterator path = byPath.find(key);
+		unsigned int id = 0;
+		if (path != byPath.end())
+			id = path->second;
+		else if (hash != 0) {
+			map<uint64_t, unsigned int>::iterator content = byHash.find(hash);
+			if (content == byHash.end()) return 0;
+			id = content->second;
+		}
+		else
+			return 0;
+
+		Entry &entry = entries[id];
+		entry.refs++;
+		stats.hits++;
+		stats.bytesSaved += entry.bytes;
+		return id;
+	}
+
+	unsigned int insert(unsigned int id, const string &key, uint64_t hash, GLenum target, unsigned long long bytes) {
+		lock_guard<mutex> lock(cacheMutex);
+		Entry entry;
+		entry.key = key;
+		entry.hash = hash;
+		entry.target = target;
+		entry.bytes = bytes;
+		entry.refs = 1;
+		entries[id] = entry;
+		byPath[key] = id;
+		if (hash != 0) byHash[hash] = id;
+		stats.misses++;
+		stats.bytesUploaded += bytes;
+		return id;
+	}
+};
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef TEXTURECONTAINER_H
+#define TEXTURECONTAINER_H
+
+#include <glad/glad.h>
+
+#include <virtualfile.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+using namespace std;
+
+// S3TC is an extension, our glad only carries the core enums
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// Container written by the TextureBaker tool next to the source image ("image.png.ctex"): a full
+// mip chain of block-compressed data, ready for glCompressedTexImage2D.
+//
+// Layout: TextureContainerHeader, one TextureContainerLevel per mip level, then the block data.
+#define TEXTURE_CONTAINER_MAGIC     "CTEX"
+#define TEXTURE_CONTAINER_VERSION   1
+#define TEXTURE_CONTAINER_EXTENSION ".ctex"
+
+enum BlockFormat
+{
+	BLOCK_BC1 = 1, // RGB, 1-bit alpha. 8 bytes per 4x4 block
+	BLOCK_BC3 = 2, // RGBA. 16 bytes
+	BLOCK_BC5 = 3, // two channels (normal map XY). 16 bytes
+	BLOCK_BC7 = 4  // RGBA, high quality. 16 bytes
+};
+
+struct TextureContainerHeader
+{
+	char     magic[4];
+	uint32_t version;
+	uint32_t format;     // BlockFormat
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	uint32_t reserved[2];
+};
+
+struct TextureContainerLevel
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t size;
+	uint32_t offset; // from the start of the file
+};
+
+inline unsigned int BlockFormatBytes(unsigned int format)
+{
+	return format == BLOCK_BC1 ? 8 : 16;
+}
+
+inline GLenum BlockFormatGL(unsigned int format)
+{
+	switch (format) {
+	case BLOCK_BC1: return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+	case BLOCK_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case BLOCK_BC5: return GL_COMPRESSED_RG_RGTC2;
+	case BLOCK_BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+	}
+	return 0;
+}
+
+inline const char* BlockFormatName(unsigned int format)
+{
+	switch (format) {
+	case BLOCK_BC1: return "BC1";
+	case BLOCK_BC3: return "BC3";
+	case BLOCK_BC5: return "BC5";
+	case BLOCK_BC7: return "BC7";
+	}
+	return "?";
+}
+
+// Which BlockFormats the driver can sample, a bit per format. We ask for a 3.3 context: RGTC
+// (BC5) is core there, but S3TC (BC1, BC3) is an extension and BPTC (BC7) is core only from
+// 4.2. Filled by QueryBlockFormats on the context thread, before any texture is decoded, and
+// read by the decoding threads.
+inline atomic<unsigned int>& BlockFormatMask()
+{
+	static atomic<unsigned int> mask(0);
+	return mask;
+}
+
+inline bool BlockFormatSupported(unsigned int format)
+{
+	return (BlockFormatMask().load() & (1u << format)) != 0;
+}
+
+inline bool HasGLExtension(const char *name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++) {
+		const GLubyte *extension = glGetStringi(GL_EXTENSIONS, (GLuint)i);
+		if (extension != NULL && strcmp((const char*)extension, name) == 0) return true;
+	}
+	return false;
+}
+
+// GL thread, once, with the context current
+inline void QueryBlockFormats()
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count);
+	vector<GLint> formats(count > 0 ? count : 0);
+	if (count > 0)
+		glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats.data());
+
+	bool s3tc = HasGLExtension("GL_EXT_texture_compression_s3tc");
+	bool bptc = GLAD_GL_VERSION_4_2 || HasGLExtension("GL_ARB_texture_compression_bptc");
+	unsigned int mask = 0;
+	for (unsigned int format = BLOCK_BC1; format <= BLOCK_BC7; format++) {
+		GLenum gl = BlockFormatGL(format);
+		bool listed = find(formats.begin(), formats.end(), (GLint)gl) != formats.end();
+		bool available = format == BLOCK_BC5 || listed ||
+			((format == BLOCK_BC1 || format == BLOCK_BC3) && s3tc) || (format == BLOCK_BC7 && bptc);
+		if (available)
+			mask |= 1u << format;
+		else
+			cout << "WARNING::TEXTURECONTAINER:: " << BlockFormatName(format) << " is not supported, its containers are skipped" << endl;
+	}
+	BlockFormatMask() = mask;
+}
+
+// size in bytes of a compressed image of the given dimensions
+inline size_t CompressedImageSize(unsigned int format, unsigned int width, unsigned int height)
+{
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * BlockFormatBytes(format);
+}
+
+// Block-compressed image with its mip chain, level 0 first
+struct CompressedTexture
+{
+	unsigned int                   format; // BlockFormat
+	unsigned int                   width;
+	unsigned int                   height;
+	vector<vector<unsigned char> > levels;
+
+	CompressedTexture() : format(0), width(0), height(0) {}
+
+	size_t Size() const {
+		size_t size = 0;
+		for (unsigned int i = 0; i < levels.size(); i++)
+			size += levels[i].size();
+		return size;
+	}
+
+	unsigned int LevelWidth(unsigned int level) const  { return width >> level ? width >> level : 1; }
+	unsigned int LevelHeight(unsigned int level) const { return height >> level ? height >> level : 1; }
+
+	// uploads every level into the bound texture target (GL_TEXTURE_2D or a cube map face)
+	void Upload(GLenum target) const {
+		for (unsigned int i = 0; i < levels.size(); i++)
+			glCompressedTexImage2D(target, i, BlockFormatGL(format), LevelWidth(i), LevelHeight(i), 0, (GLsizei)levels[i].size(), levels[i].data());
+	}
+
+	static string ContainerPath(const string &imagePath) {
+		return imagePath + TEXTURE_CONTAINER_EXTENSION;
+	}
+
+	// Reads the baked container of an image. Same rule as the mesh cache: it is used when the source
+	// is missing or not newer than the container.
+	bool Load(const string &imagePath) {
+		string path = ContainerPath(imagePath);
+		long long sourceTime, containerTime;
+		if (!VirtualFileSystem::Get().ModifiedTime(path, containerTime)) return false;
+		if (VirtualFileSystem::Get().ModifiedTime(imagePath, sourceTime) && sourceTime > containerTime) return false;
+
+		VirtualFile file;
+		if (!file.Open(path)) return false;
+		if (!parse(file.Data(), file.Size())) {
+			cout << "WARNING::TEXTURECONTAINER:: ignoring invalid container " << path << endl;
+			levels.clear();
+			return false;
+		}
+		return true;
+	}
+
+	bool Write(const string &imagePath) const {
+		string path = ContainerPath(imagePath);
+		string tempPath = path + ".tmp";
+
+		TextureContainerHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, TEXTURE_CONTAINER_MAGIC, 4);
+		header.version = TEXTURE_CONTAINER_VERSION;
+		header.format = format;
+		header.width = width;
+		header.height = height;
+		header.levelCount = (uint32_t)levels.size();
+
+		vector<TextureContainerLevel> records(levels.size());
+		uint32_t offset = (uint32_t)(sizeof(header) + records.size() * sizeof(TextureContainerLevel));
+		for (unsigned int i = 0; i < levels.size(); i++) {
+			records[i].width = LevelWidth(i);
+			records[i].height = LevelHeight(i);
+			records[i].size = (uint32_t)levels[i].size();
+			records[i].offset = offset;
+			offset += records[i].size;
+		}
+
+		{
+			ofstream out(tempPath.c_str(), ios::binary | ios::trunc);
+			if (!out) {
+				cout << "WARNING::TEXTURECONTAINER:: could not create " << tempPath << endl;
+				return false;
+			}
+			out.write((const char*)&header, sizeof(header));
+			out.write((const char*)records.data(), records.size() * sizeof(TextureContainerLevel));
+			for (unsigned int i = 0; i < levels.size(); i++)
+				out.write((const char*)levels[i].data(), levels[i].size());
+			if (!out) return false;
+		}
+		remove(path.c_str());
+		return rename(tempPath.c_str(), path.c_str()) == 0;
+	}
+
+private:
+	bool parse(const unsigned char *data, size_t size) {
+		if (size < sizeof(TextureContainerHeader)) return false;
+		const TextureContainerHeader *header = (const TextureContainerHeader*)data;
+		if (memcmp(header->magic, TEXTURE_CONTAINER_MAGIC, 4) != 0 || header->version != TEXTURE_CONTAINER_VERSION)
+			return false;
+		if (BlockFormatGL(header->format) == 0 || header->levelCount == 0 || header->levelCount > 16)
+			return false;
+
+		format = header->format;
+		width = header->width;
+		height = header->height;
+		size_t recordsEnd = sizeof(TextureContainerHeader) + header->levelCount * sizeof(TextureContainerLevel);
+		if (recordsEnd > size) return false;
+
+		const TextureContainerLevel *records = (const TextureContainerLevel*)(data + sizeof(TextureContainerHeader));
+		levels.resize(header->levelCount);
+		for (unsigned int i = 0; i < header->levelCount; i++) {
+			const TextureContainerLevel &record = records[i];
+			if (record.width != LevelWidth(i) || record.height != LevelHeight(i)) return false;
+			if (record.size != CompressedImageSize(format, record.width, record.height)) return false;
+			if ((size_t)record.offset + record.size > size) return false;
+			levels[i].assign(data + record.offset, data + record.offset + record.size);
+		}
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef TEXTUREREDIRECTS_H
+#define TEXTUREREDIRECTS_H
+
+#include <map>
+using namespace std;
+
+// Texture ids held by materials that stand for another texture: the placeholders of streamed
+// files that turned out to hold an image already cached (see TextureCache::Redirect). Kept
+// apart from the cache so the meshes can resolve ids when binding without including it.
+// GL thread only.
+class TextureRedirects
+{
+public:
+	static TextureRedirects& Get() {
+		static TextureRedirects instance;
+		return instance;
+	}
+
+	// the texture to bind for 'id': itself unless it was redirected
+	unsigned int Resolve(unsigned int id) const {
+		if (redirects.empty()) return id;
+		map<unsigned int, unsigned int>::const_iterator it = redirects.find(id);
+		return it != redirects.end() ? it->second : id;
+	}
+
+	void Add(unsigned int from, unsigned int to) { redirects[from] = to; }
+	void Remove(unsigned int from) { redirects.erase(from); }
+
+private:
+	map<unsigned int, unsigned int> redirects;
+
+	TextureRedirects() {}
+	TextureRedirects(const TextureRedirects&);
+	TextureRedirects& operator=(const TextureRedirects&);
+};
+
+#endif
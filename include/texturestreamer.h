@@ -0,0 +1,209 @@
+#ifndef TEXTURESTREAMER_H
+#define TEXTURESTREAMER_H
+
+#include <glad/glad.h>
+
+#include <loadprofiler.h>
+#include <modelstructs.h>
+#include <texturecache.h>
+#include <threadpool.h>
+
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <string.h>
+using namespace std;
+
+// Loads 2D textures without stalling the render thread. Request() hands back a texture right
+// away holding a 1x1 placeholder; the file is decoded on worker threads and Update(), called
+// once per frame, copies the finished images into the same texture names through a pixel
+// buffer object. Meshes keep the id they were given, so the swap needs no extra bookkeeping.
+// The workers hash the files: one holding an image that is already cached (the same JPEG in
+// several .fbm folders) is not decoded or uploaded again, its placeholder is redirected to the
+// cached texture instead (see TextureCache::Redirect).
+class TextureStreamer
+{
+public:
+	explicit TextureStreamer(unsigned int numThreads = 2) : pool(numThreads), pbo(0), streamedTextures(0), redirectedTextures(0), streamedBytes(0) {}
+
+	~TextureStreamer() {
+		if (pbo != 0) glDeleteBuffers(1, &pbo);
+	}
+
+	// Texture for an image file, shared through the TextureCache. GL thread only.
+	unsigned int Request(const string &filename, bool normalMap = false) {
+		TextureCache &cache = TextureCache::Get();
+		string canonical = CanonicalPath(filename);
+		unsigned int id = cache.Find(canonical, 0);
+		if (id != 0) return id;
+
+		// flat normal for normal maps, mid grey for the rest
+		const unsigned char grey[4] = { 128, 128, 128, 255 };
+		const unsigned char flat[4] = { 128, 128, 255, 255 };
+		id = createPlaceholder(normalMap ? flat : grey);
+		cache.Insert(id, canonical, 0, GL_TEXTURE_2D, 0);
+		cache.Retain(id); // kept by the job, so the name stays valid until the upload
+
+		Job job;
+		job.id = id;
+		job.decoding = pool.Submit([filename]() { return TextureCache::Get().DecodeStreamed(filename); });
+		job.decoded = false;
+		jobs.push_back(std::move(job));
+		return id;
+	}
+
+	// Uploads the images decoded so far, stopping once either budget is spent. At least one
+	// image is uploaded per call, so a texture larger than the byte budget is never starved.
+	void Update(size_t byteBudget = 8 * 1024 * 1024, double timeBudgetMs = 2.0) {
+		if (jobs.empty()) return;
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		size_t bytes = 0;
+		for (size_t i = 0; i < jobs.size();) {
+			Job &job = jobs[i];
+			if (!job.decoded) {
+				if (job.decoding.wait_for(chrono::seconds(0)) != future_status::ready) {
+					i++;
+					continue;
+				}
+				job.image = job.decoding.get();
+				job.decoded = true;
+			}
+
+			size_t size = job.image.GPUSize();
+			double elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+			if (bytes > 0 && (bytes + size > byteBudget || elapsedMs >= timeBudgetMs))
+				break;
+
+			// same contents as a texture cached meanwhile: share it
+			unsigned int cached = TextureCache::Get().FindContent(job.image.contentHash);
+			if (cached != 0 && cached != job.id) {
+				TextureCache::Get().Redirect(job.id, cached);
+				TextureCache::Get().Release(job.id); // the reference of the job, now on the cached texture
+				redirectedTextures++;
+				jobs.erase(jobs.begin() + i);
+				continue;
+			}
+			// the worker skipped an image that was cached then but has been released since
+			if (!job.image.IsLoaded() && job.image.contentHash != 0)
+				job.image = LoadTextureImage(job.image.path);
+
+			if (job.image.IsLoaded()) {
+				LoadTimer timer(job.image.path, "texture", "upload");
+				upload(job.id, job.image);
+				LoadProfiler::Get().AddTextureBytes(job.image.path, "texture", size);
+				TextureCache::Get().SetContent(job.id, job.image.contentHash, size);
+				bytes += size;
+				streamedTextures++;
+				streamedBytes += size;
+			}
+			TextureCache::Get().Release(job.id);
+			jobs.erase(jobs.begin() + i);
+		}
+
+		if (jobs.empty())
+			cout << "TextureStreamer: " << streamedTextures << " textures, " << streamedBytes / 1024 << " KB streamed, "
+				<< redirectedTextures << " shared with a cached copy" << endl;
+	}
+
+	// textures still showing their placeholder
+	unsigned int Pending() const { return (unsigned int)jobs.size(); }
+
+private:
+	struct Job
+	{
+		unsigned int         id;
+		future<TextureImage> decoding;
+		TextureImage         image;
+		bool                 decoded;
+	};
+
+	ThreadPool         pool;
+	vector<Job>        jobs;
+	unsigned int       pbo;
+	unsigned int       streamedTextures;
+	unsigned int       redirectedTextures;
+	unsigned long long streamedBytes;
+
+	unsigned int createPlaceholder(const unsigned char color[4]) {
+		unsigned int id;
+		glGenTextures(1, &id);
+		glBindTexture(GL_TEXTURE_2D, id);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, color);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		return id;
+	}
+
+	void upload(unsigned int id, const TextureImage &image) {
+		if (image.compressed) {
+			uploadCompressed(id, *image.compressed);
+			return;
+		}
+
+		size_t size = (size_t)image.width * image.height * image.components;
+		GLenum format = TextureImageFormat(image);
+
+		if (pbo == 0) glGenBuffers(1, &pbo);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+		// orphan the previous storage, the driver may still be reading it for the last upload
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+		void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		const void *pixels = nullptr; // offset into the PBO
+		if (mapped != nullptr) {
+			memcpy(mapped, image.data, size);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+		else {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			pixels = image.data;
+		}
+
+		glBindTexture(GL_TEXTURE_2D, id);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, pixels);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	// baked mip chain: every level goes through the PBO in one copy
+	void uploadCompressed(unsigned int id, const CompressedTexture &texture) {
+		size_t size = texture.Size();
+
+		if (pbo == 0) glGenBuffers(1, &pbo);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+		unsigned char *mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+		glBindTexture(GL_TEXTURE_2D, id);
+		if (mapped != nullptr) {
+			size_t offset = 0;
+			for (unsigned int i = 0; i < texture.levels.size(); i++) {
+				memcpy(mapped + offset, texture.levels[i].data(), texture.levels[i].size());
+				offset += texture.levels[i].size();
+			}
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+			offset = 0;
+			for (unsigned int i = 0; i < texture.levels.size(); i++) {
+				glCompressedTexImage2D(GL_TEXTURE_2D, i, BlockFormatGL(texture.format), texture.LevelWidth(i), texture.LevelHeight(i), 0,
+					(GLsizei)texture.levels[i].size(), (const void*)offset);
+				offset += texture.levels[i].size();
+			}
+		}
+		else {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			texture.Upload(GL_TEXTURE_2D);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)texture.levels.size() - 1);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	TextureStreamer(const TextureStreamer&);
+	TextureStreamer& operator=(const TextureStreamer&);
+};
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads consuming a FIFO of tasks. Submit() returns a future with the
+// result of the task; the destructor finishes the queued tasks before joining the workers.
+class ThreadPool
+{
+public:
+	explicit ThreadPool(unsigned int numThreads = 0) : stopping(false) {
+		if (numThreads == 0) {
+			numThreads = std::thread::hardware_concurrency();
+			if (numThreads == 0) numThreads = 4;
+		}
+		for (unsigned int i = 0; i < numThreads; i++)
+			workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			stopping = true;
+		}
+		wakeUp.notify_all();
+		for (unsigned int i = 0; i < workers.size(); i++)
+			workers[i].join();
+	}
+
+	template <class F>
+	auto Submit(F task) -> std::future<decltype(task())> {
+		typedef decltype(task()) Result;
+		// packaged_task is move-only, std::function needs something copyable
+		std::shared_ptr<std::packaged_task<Result()> > packaged = std::make_shared<std::packaged_task<Result()> >(task);
+		std::future<Result> result = packaged->get_future();
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			tasks.push([packaged]() { (*packaged)(); });
+		}
+		wakeUp.notify_one();
+		return result;
+	}
+
+	unsigned int Size() const { return (unsigned int)workers.size(); }
+
+private:
+	std::vector<std::thread>          workers;
+	std::queue<std::function<void()> > tasks;
+	std::mutex                        queueMutex;
+	std::condition_variable           wakeUp;
+	bool                              stopping;
+
+	void workerLoop() {
+		for (;;) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				wakeUp.wait(lock, [this]() { return stopping || !tasks.empty(); });
+				if (tasks.empty()) return; // stopping and nothing left to do
+				task = std::move(tasks.front());
+				tasks.pop();
+			}
+			task();
+		}
+	}
+
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+};
+
+// Helpers shared by every ParallelFor, one per hardware thread besides the caller, started on
+// first use. Concurrent and nested calls (the asset manager converts several models at once,
+// each one with a ParallelFor per stage) queue on them instead of starting threads of their own.
+inline ThreadPool& ParallelForPool()
+{
+	static ThreadPool pool(std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 3);
+	return pool;
+}
+
+// Calls body(i) for every i in [0, count) using up to numThreads threads, the calling one included
+// (0 = one per hardware thread). Returns when all the calls have finished. The caller takes part
+// and only waits for the helpers that did start, so it is safe to use from inside a ThreadPool
+// task, and from inside another ParallelFor, even while every helper is busy.
+template <class F>
+void ParallelFor(unsigned int count, F body, unsigned int numThreads = 0)
+{
+	ThreadPool &pool = ParallelForPool();
+	if (numThreads == 0 || numThreads > pool.Size() + 1) numThreads = pool.Size() + 1;
+	if (numThreads > count) numThreads = count;
+
+	if (numThreads <= 1) {
+		for (unsigned int i = 0; i < count; i++)
+			body(i);
+		return;
+	}
+
+	// outlives the call: a helper that starts after the caller returned finds 'finished' set
+	struct State
+	{
+		std::atomic<unsigned int> next;
+		std::mutex                mtx;
+		std::condition_variable   idle;
+		unsigned int              running;
+		bool                      finished;
+	};
+	std::shared_ptr<State> state = std::make_shared<State>();
+	state->next = 0;
+	state->running = 0;
+	state->finished = false;
+
+	F *shared = &body;
+	for (unsigned int t = 1; t < numThreads; t++) {
+		pool.Submit([state, shared, count]() {
+			{
+				std::lock_guard<std::mutex> lock(state->mtx);
+				if (state->finished) return;
+				state->running++;
+			}
+			for (unsigned int i = state->next++; i < count; i = state->next++)
+				(*shared)(i);
+			std::lock_guard<std::mutex> lock(state->mtx);
+			state->running--;
+			state->idle.notify_all();
+		});
+	}
+
+	for (unsigned int i = state->next++; i < count; i = state->next++)
+		body(i);
+
+	std::unique_lock<std::mutex> lock(state->mtx);
+	state->finished = true;
+	state->idle.wait(lock, [&state]() { return state->running == 0; });
+}
+
+#endif
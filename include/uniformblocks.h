@@ -0,0 +1,143 @@
+#ifndef UNIFORMBLOCKS_H
+#define UNIFORMBLOCKS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <light.h>
+
+#include <iostream>
+#include <vector>
+#include <stddef.h>
+using namespace std;
+
+// Shared uniform blocks
+// ---------------------
+// What is the same for every program in a frame lives in two std140 uniform blocks instead of
+// loose uniforms set on each program: "FrameData" (view, projection, camera position and time)
+// and "LightData" (the scene lights). The shaders in bin/shaders declare them identically, a
+// program is bound to the fixed binding points below when it is linked (a 3.3 context has no
+// layout(binding = n)), and FrameUniforms fills each buffer with a single update per frame.
+
+#define FRAME_DATA_BINDING 0
+#define LIGHT_DATA_BINDING 1
+
+// allLights[MAX_LIGHTS] in 11_PhongShaderMultLights.fs
+#define MAX_LIGHTS 10
+
+// layout (std140) uniform FrameData
+struct FrameDataStd140
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 cameraPosition;
+	float     frameTime;      // packs into the 4th component of cameraPosition
+};
+
+// struct Light of the shaders: a vec3 takes 16 bytes, the struct rounds up to a multiple of 16
+struct LightStd140
+{
+	glm::vec3 position;
+	float     pad0;
+	glm::vec3 direction;
+	float     pad1;
+	glm::vec4 color;
+	glm::vec4 power;
+	int       alphaIndex;
+	float     distance;
+	float     pad2[2];
+};
+
+// layout (std140) uniform LightData; the array starts at the next multiple of 16
+struct LightDataStd140
+{
+	int         numLights;
+	int         pad[3];
+	LightStd140 lights[MAX_LIGHTS];
+};
+
+static_assert(sizeof(FrameDataStd140) == 144, "FrameData does not match its std140 layout");
+static_assert(sizeof(LightStd140) == 80, "Light does not match its std140 layout");
+static_assert(sizeof(LightDataStd140) == 16 + 80 * MAX_LIGHTS, "LightData does not match its std140 layout");
+
+// Binds the shared blocks a linked program declares to their binding points. Programs that do
+// not use them are left alone.
+inline void BindUniformBlocks(GLuint program)
+{
+	GLuint frameBlock = glGetUniformBlockIndex(program, "FrameData");
+	if (frameBlock != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, frameBlock, FRAME_DATA_BINDING);
+	GLuint lightBlock = glGetUniformBlockIndex(program, "LightData");
+	if (lightBlock != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, lightBlock, LIGHT_DATA_BINDING);
+}
+
+// The buffers behind the shared blocks, bound once to their binding points. Context thread.
+class FrameUniforms
+{
+public:
+	FrameUniforms() {
+		glGenBuffers(1, &frameUBO);
+		glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameDataStd140), NULL, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, frameUBO);
+
+		glGenBuffers(1, &lightUBO);
+		glBindBuffer(GL_UNIFORM_BUFFER, lightUBO);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(LightDataStd140), NULL, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_DATA_BINDING, lightUBO);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		lightData = LightDataStd140();
+	}
+
+	~FrameUniforms() {
+		glDeleteBuffers(1, &frameUBO);
+		glDeleteBuffers(1, &lightUBO);
+	}
+
+	// Camera and time of this frame, for every program at once
+	void SetFrame(const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &cameraPosition, float time) {
+		FrameDataStd140 frame;
+		frame.view = view;
+		frame.projection = projection;
+		frame.cameraPosition = cameraPosition;
+		frame.frameTime = time;
+		glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frame), &frame);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	// The light list, in world space. Only the lights in use are sent.
+	void SetLights(const vector<Light> &lights) {
+		size_t count = lights.size();
+		if (count > MAX_LIGHTS) {
+			if (!warnedLights)
+				cout << "WARNING::FRAMEUNIFORMS::" << count << " lights, the shaders take " << MAX_LIGHTS << endl;
+			warnedLights = true;
+			count = MAX_LIGHTS;
+		}
+		lightData.numLights = (int)count;
+		for (size_t i = 0; i < count; i++) {
+			LightStd140 &light = lightData.lights[i];
+			light.position = lights[i].Position;
+			light.direction = lights[i].Direction;
+			light.color = lights[i].Color;
+			light.power = lights[i].Power;
+			light.alphaIndex = lights[i].alphaIndex;
+			light.distance = lights[i].distance;
+		}
+		GLsizeiptr bytes = (GLsizeiptr)(offsetof(LightDataStd140, lights) + count * sizeof(LightStd140));
+		glBindBuffer(GL_UNIFORM_BUFFER, lightUBO);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, bytes, &lightData);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+private:
+	GLuint          frameUBO;
+	GLuint          lightUBO;
+	LightDataStd140 lightData;
+	bool            warnedLights = false;
+};
+
+#endif
@@ -0,0 +1,402 @@
+#ifndef VERTEXLAYOUT_H
+#define VERTEXLAYOUT_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <vector>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+using namespace std;
+
+// influences a Vertex can hold, in groups of four (IDs1..3 / Weights1..3)
+#define VERTEX_BONE_GROUPS 3
+
+// Vertex as it comes out of the importer. What reaches the GPU is decided by a VertexLayout.
+struct Vertex {
+    // position
+    glm::vec3 Position;
+    // normal
+    glm::vec3 Normal;
+    // texCoords
+    glm::vec2 TexCoords;
+    // tangent
+    glm::vec3 Tangent;
+    // bitangent
+    glm::vec3 Bitangent;
+	// bone data
+	glm::vec4 IDs1; // 4 bones
+	glm::vec4 IDs2; // 4 bones
+	glm::vec4 IDs3; // 4 bones
+	glm::vec4 Weights1;
+	glm::vec4 Weights2;
+	glm::vec4 Weights3;
+};
+
+// Attribute locations every shader declares
+enum VertexAttributeLocation
+{
+	ATTRIB_POSITION     = 0,
+	ATTRIB_NORMAL       = 1,
+	ATTRIB_TEXCOORDS    = 2,
+	ATTRIB_TANGENT      = 3,
+	ATTRIB_BITANGENT    = 4,
+	ATTRIB_BONE_IDS     = 5, // 5..7, one per bone group
+	ATTRIB_BONE_WEIGHTS = 8  // 8..10
+};
+
+// A mesh with fewer bone groups than the skinning shader reads leaves those inputs disabled, and
+// a disabled input reads the current generic value, (0, 0, 0, 1) unless set. Sets it to no bone
+// with no weight for every group; the values are context state, not part of the vertex arrays.
+inline void ResetBoneAttributeDefaults()
+{
+	for (GLuint g = 0; g < VERTEX_BONE_GROUPS; g++) {
+		glVertexAttribI4ui(ATTRIB_BONE_IDS + g, 0, 0, 0, 0);
+		glVertexAttrib4f(ATTRIB_BONE_WEIGHTS + g, 0.0f, 0.0f, 0.0f, 0.0f);
+	}
+}
+
+// How the attributes are stored. All encodings are normalized or converted by the vertex fetch,
+// so the shaders keep reading vec3/vec2/vec4 floats whatever the format; the bone ids are the
+// exception, integer attributes the shaders read as uvec4 and index the bone array with directly.
+struct VertexFormat
+{
+	bool         packedNormals; // normal and tangent as 10:10:10:2 snorm, the bitangent sign in the tangent w (no bitangent stream)
+	bool         halfTexCoords; // 16-bit float UVs
+	unsigned int weightBits;    // 8 or 16: unorm weights; 32: float weights (bone ids are always integers)
+
+	// packed by default
+	VertexFormat() : packedNormals(true), halfTexCoords(true), weightBits(8) {}
+
+	// the old layout, everything in floats
+	static VertexFormat Full() {
+		VertexFormat format;
+		format.packedNormals = false;
+		format.halfTexCoords = false;
+		format.weightBits = 32;
+		return format;
+	}
+
+	// stored in the mesh cache
+	uint32_t Key() const {
+		return (packedNormals ? 1u : 0u) | (halfTexCoords ? 2u : 0u) | (weightBits << 2);
+	}
+
+	static VertexFormat FromKey(uint32_t key) {
+		VertexFormat format;
+		format.packedNormals = (key & 1u) != 0;
+		format.halfTexCoords = (key & 2u) != 0;
+		format.weightBits = (key >> 2) & 0x3F;
+		return format;
+	}
+
+	bool IsValid() const { return weightBits == 8 || weightBits == 16 || weightBits == 32; }
+
+	bool operator==(const VertexFormat &other) const { return Key() == other.Key(); }
+	bool operator!=(const VertexFormat &other) const { return Key() != other.Key(); }
+};
+
+// The attributes are split in streams, each one a separate block of the vertex buffer, so a
+// pass only fetches the bytes of the attributes its shader reads (position alone for depth or
+// picking, no skinning data for the static shaders).
+enum VertexStream
+{
+	STREAM_POSITION = 0,
+	STREAM_SHADING  = 1, // normal, UVs, tangent frame
+	STREAM_SKINNING = 2, // bone ids and weights
+	VERTEX_STREAM_COUNT
+};
+
+struct VertexAttribute
+{
+	GLuint       location;
+	GLint        components;
+	GLenum       type;
+	GLboolean    normalized;
+	bool         integer;    // read with glVertexAttribIPointer, not converted to float
+	unsigned int stream;
+	GLuint       offset; // inside a vertex of its stream
+};
+
+// Layout of the vertices of one mesh: a format plus the bone streams the mesh actually needs.
+// Static meshes get no bone attributes at all; skinned ones only the groups of four influences
+// some vertex uses. Every stream is interleaved on its own and the streams follow each other in
+// the buffer: all positions, then all shading data, then the skinning data.
+struct VertexLayout
+{
+	VertexFormat            format;
+	unsigned int            boneGroups;     // 0 for static meshes
+	unsigned int            boneIndexBytes; // 1 or 2 per id in the packed formats, 4 in the full one
+	unsigned int            stride;         // bytes per vertex over all the streams
+	unsigned int            streamStrides[VERTEX_STREAM_COUNT];
+	vector<VertexAttribute> attributes;
+
+	VertexLayout() : boneGroups(0), boneIndexBytes(0), stride(0) {
+		for (unsigned int i = 0; i < VERTEX_STREAM_COUNT; i++)
+			streamStrides[i] = 0;
+	}
+
+	static VertexLayout Create(const VertexFormat &format, unsigned int boneGroups, unsigned int boneIndexBytes) {
+		VertexLayout layout;
+		layout.format = format;
+		layout.boneGroups = min(boneGroups, (unsigned int)VERTEX_BONE_GROUPS);
+		layout.boneIndexBytes = format.weightBits == 32 ? 4 : (boneIndexBytes > 1 ? 2 : 1);
+
+		layout.add(STREAM_POSITION, ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, 12);
+		if (format.packedNormals)
+			layout.add(STREAM_SHADING, ATTRIB_NORMAL, 4, GL_INT_2_10_10_10_REV, GL_TRUE, 4);
+		else
+			layout.add(STREAM_SHADING, ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, 12);
+		if (format.halfTexCoords)
+			layout.add(STREAM_SHADING, ATTRIB_TEXCOORDS, 2, GL_HALF_FLOAT, GL_FALSE, 4);
+		else
+			layout.add(STREAM_SHADING, ATTRIB_TEXCOORDS, 2, GL_FLOAT, GL_FALSE, 8);
+		if (format.packedNormals)
+			layout.add(STREAM_SHADING, ATTRIB_TANGENT, 4, GL_INT_2_10_10_10_REV, GL_TRUE, 4);
+		else {
+			layout.add(STREAM_SHADING, ATTRIB_TANGENT, 3, GL_FLOAT, GL_FALSE, 12);
+			layout.add(STREAM_SHADING, ATTRIB_BITANGENT, 3, GL_FLOAT, GL_FALSE, 12);
+		}
+
+		// ids stay integers up to the shader (uvec4), no int -> float -> int round trip per influence
+		GLenum idType = layout.boneIndexBytes == 4 ? GL_UNSIGNED_INT : (layout.boneIndexBytes == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE);
+		GLenum weightType = format.weightBits == 32 ? GL_FLOAT : (format.weightBits == 16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE);
+		for (unsigned int g = 0; g < layout.boneGroups; g++)
+			layout.add(STREAM_SKINNING, ATTRIB_BONE_IDS + g, 4, idType, GL_FALSE, 4 * layout.boneIndexBytes, true);
+		for (unsigned int g = 0; g < layout.boneGroups; g++)
+			layout.add(STREAM_SKINNING, ATTRIB_BONE_WEIGHTS + g, 4, weightType, weightType == GL_FLOAT ? GL_FALSE : GL_TRUE, format.weightBits / 2);
+		return layout;
+	}
+
+	// layout for the given vertices: as many bone groups as their influences need
+	static VertexLayout For(const VertexFormat &format, const Vertex *vertices, unsigned int count) {
+		unsigned int groups = 0, maxBone = 0;
+		for (unsigned int i = 0; i < count; i++) {
+			for (unsigned int slot = 0; slot < VERTEX_BONE_GROUPS * 4; slot++) {
+				if (weight(vertices[i], slot) > 0.0f) {
+					groups = max(groups, slot / 4 + 1);
+					maxBone = max(maxBone, (unsigned int)boneID(vertices[i], slot));
+				}
+			}
+		}
+		return Create(format, groups, maxBone < 256 ? 1 : 2);
+	}
+
+	// influences per vertex the layout holds, what the skinning shader has to read
+	unsigned int Influences() const { return boneGroups * 4; }
+
+	// stored in the mesh cache
+	uint32_t Key() const {
+		return format.Key() | (boneGroups << 8) | (boneIndexBytes << 12);
+	}
+
+	static VertexLayout FromKey(uint32_t key) {
+		return Create(VertexFormat::FromKey(key & 0xFF), (key >> 8) & 0xF, (key >> 12) & 0xF);
+	}
+
+	size_t Size(unsigned int vertexCount) const { return (size_t)stride * vertexCount; }
+
+	// where a stream starts in a buffer of vertexCount vertices (strides are multiples of 4, so
+	// every stream stays aligned)
+	size_t StreamOffset(unsigned int stream, unsigned int vertexCount) const {
+		size_t offset = 0;
+		for (unsigned int i = 0; i < stream; i++)
+			offset += (size_t)streamStrides[i] * vertexCount;
+		return offset;
+	}
+
+	// bit per attribute location the layout provides
+	unsigned int AttributeMask() const {
+		unsigned int mask = 0;
+		for (unsigned int i = 0; i < attributes.size(); i++)
+			mask |= 1u << attributes[i].location;
+		return mask;
+	}
+
+	// Sets the attribute pointers of the locations in 'mask' for the vertex buffer bound to
+	// GL_ARRAY_BUFFER, on the bound VAO. 'baseOffset' is where the vertices start in the buffer.
+	void Apply(unsigned int vertexCount, unsigned int mask = ~0u, size_t baseOffset = 0) const {
+		for (unsigned int i = 0; i < attributes.size(); i++) {
+			const VertexAttribute &attribute = attributes[i];
+			if ((mask & (1u << attribute.location)) == 0) continue;
+			size_t offset = baseOffset + StreamOffset(attribute.stream, vertexCount) + attribute.offset;
+			glEnableVertexAttribArray(attribute.location);
+			if (attribute.integer)
+				glVertexAttribIPointer(attribute.location, attribute.components, attribute.type,
+					streamStrides[attribute.stream], (void*)(uintptr_t)offset);
+			else
+				glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalized,
+					streamStrides[attribute.stream], (void*)(uintptr_t)offset);
+		}
+	}
+
+	// encodes the vertices into 'out', which must hold Size(count) bytes
+	void Pack(const Vertex *vertices, unsigned int count, unsigned char *out) const {
+		unsigned char *positions = out + StreamOffset(STREAM_POSITION, count);
+		unsigned char *shading = out + StreamOffset(STREAM_SHADING, count);
+		unsigned char *skinning = out + StreamOffset(STREAM_SKINNING, count);
+		for (unsigned int i = 0; i < count; i++) {
+			const Vertex &vertex = vertices[i];
+
+			write(positions + (size_t)i * streamStrides[STREAM_POSITION], &vertex.Position, 12);
+
+			unsigned char *dst = shading + (size_t)i * streamStrides[STREAM_SHADING];
+			if (format.packedNormals) {
+				glm::vec3 normal = safeNormalize(vertex.Normal);
+				glm::vec3 tangent = safeNormalize(vertex.Tangent);
+				float sign = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+				uint32_t packedNormal = glm::packSnorm3x10_1x2(glm::vec4(normal, 0.0f));
+				dst = write(dst, &packedNormal, 4);
+				dst = writeTexCoords(dst, vertex.TexCoords);
+				uint32_t packedTangent = glm::packSnorm3x10_1x2(glm::vec4(tangent, sign));
+				dst = write(dst, &packedTangent, 4);
+			}
+			else {
+				dst = write(dst, &vertex.Normal, 12);
+				dst = writeTexCoords(dst, vertex.TexCoords);
+				dst = write(dst, &vertex.Tangent, 12);
+				dst = write(dst, &vertex.Bitangent, 12);
+			}
+
+			if (boneGroups > 0)
+				writeBones(skinning + (size_t)i * streamStrides[STREAM_SKINNING], vertex);
+		}
+	}
+
+	// Moves 'count' vertices packed with this layout by 'transform': positions by the matrix,
+	// normals by its inverse transpose and tangents by its upper 3x3, renormalized. A mirroring
+	// matrix flips the bitangent sign, the caller has to flip the triangle winding.
+	void Transform(unsigned char *data, unsigned int count, const glm::mat4 &transform) const {
+		glm::mat3 linear(transform);
+		glm::mat3 normalMatrix = glm::transpose(glm::inverse(linear));
+		float handedness = glm::determinant(linear) < 0.0f ? -1.0f : 1.0f;
+		unsigned char *positions = data + StreamOffset(STREAM_POSITION, count);
+		unsigned char *shading = data + StreamOffset(STREAM_SHADING, count);
+		for (unsigned int i = 0; i < count; i++) {
+			unsigned char *position = positions + (size_t)i * streamStrides[STREAM_POSITION];
+			glm::vec3 p;
+			memcpy(&p, position, 12);
+			p = glm::vec3(transform * glm::vec4(p, 1.0f));
+			memcpy(position, &p, 12);
+
+			unsigned char *dst = shading + (size_t)i * streamStrides[STREAM_SHADING];
+			if (format.packedNormals) {
+				uint32_t packedNormal, packedTangent;
+				unsigned char *tangentBytes = dst + 4 + (format.halfTexCoords ? 4 : 8);
+				memcpy(&packedNormal, dst, 4);
+				memcpy(&packedTangent, tangentBytes, 4);
+				glm::vec4 normal = glm::unpackSnorm3x10_1x2(packedNormal);
+				glm::vec4 tangent = glm::unpackSnorm3x10_1x2(packedTangent);
+				packedNormal = glm::packSnorm3x10_1x2(glm::vec4(safeNormalize(normalMatrix * glm::vec3(normal)), normal.w));
+				packedTangent = glm::packSnorm3x10_1x2(glm::vec4(safeNormalize(linear * glm::vec3(tangent)), tangent.w * handedness));
+				memcpy(dst, &packedNormal, 4);
+				memcpy(tangentBytes, &packedTangent, 4);
+			}
+			else {
+				unsigned char *tangentBytes = dst + 12 + (format.halfTexCoords ? 4 : 8);
+				glm::vec3 normal, tangent, bitangent;
+				memcpy(&normal, dst, 12);
+				memcpy(&tangent, tangentBytes, 12);
+				memcpy(&bitangent, tangentBytes + 12, 12);
+				normal = safeNormalize(normalMatrix * normal);
+				tangent = safeNormalize(linear * tangent);
+				bitangent = safeNormalize(linear * bitangent);
+				memcpy(dst, &normal, 12);
+				memcpy(tangentBytes, &tangent, 12);
+				memcpy(tangentBytes + 12, &bitangent, 12);
+			}
+		}
+	}
+
+private:
+	void add(unsigned int stream, GLuint location, GLint components, GLenum type, GLboolean normalized, unsigned int bytes, bool integer = false) {
+		VertexAttribute attribute = { location, components, type, normalized, integer, stream, streamStrides[stream] };
+		attributes.push_back(attribute);
+		streamStrides[stream] += bytes;
+		stride += bytes;
+	}
+
+	static float weight(const Vertex &vertex, unsigned int slot) {
+		const glm::vec4 &group = slot < 4 ? vertex.Weights1 : (slot < 8 ? vertex.Weights2 : vertex.Weights3);
+		return group[slot % 4];
+	}
+
+	static float boneID(const Vertex &vertex, unsigned int slot) {
+		const glm::vec4 &group = slot < 4 ? vertex.IDs1 : (slot < 8 ? vertex.IDs2 : vertex.IDs3);
+		return group[slot % 4];
+	}
+
+	static glm::vec3 safeNormalize(const glm::vec3 &v) {
+		float length = glm::length(v);
+		return length > 0.0f ? v / length : v;
+	}
+
+	static unsigned char* write(unsigned char *dst, const void *src, size_t size) {
+		memcpy(dst, src, size);
+		return dst + size;
+	}
+
+	unsigned char* writeTexCoords(unsigned char *dst, const glm::vec2 &uv) const {
+		if (!format.halfTexCoords)
+			return write(dst, &uv, 8);
+		uint16_t half[2] = { glm::packHalf1x16(uv.x), glm::packHalf1x16(uv.y) };
+		return write(dst, half, 4);
+	}
+
+	// ids of every group first, then the weights, as in the attribute list
+	void writeBones(unsigned char *dst, const Vertex &vertex) const {
+		unsigned int slots = boneGroups * 4;
+		for (unsigned int slot = 0; slot < slots; slot++) {
+			uint32_t id = weight(vertex, slot) > 0.0f ? (uint32_t)boneID(vertex, slot) : 0u;
+			if (boneIndexBytes == 4)
+				dst = write(dst, &id, 4);
+			else if (boneIndexBytes == 2) {
+				uint16_t value = (uint16_t)id;
+				dst = write(dst, &value, 2);
+			}
+			else
+				*dst++ = (unsigned char)id;
+		}
+
+		if (format.weightBits == 32) {
+			for (unsigned int slot = 0; slot < slots; slot++) {
+				float value = weight(vertex, slot);
+				dst = write(dst, &value, 4);
+			}
+			return;
+		}
+
+		// Rounded to unorm, then the rounding error goes to the largest weight so the quantized
+		// weights still add up to what the float ones did (1 for a normalized vertex).
+		const unsigned int one = format.weightBits == 16 ? 65535u : 255u;
+		unsigned int quantized[VERTEX_BONE_GROUPS * 4];
+		float total = 0.0f;
+		int sum = 0;
+		unsigned int largest = 0;
+		for (unsigned int slot = 0; slot < slots; slot++) {
+			float value = glm::clamp(weight(vertex, slot), 0.0f, 1.0f);
+			quantized[slot] = (unsigned int)floorf(value * one + 0.5f);
+			total += value;
+			sum += (int)quantized[slot];
+			if (quantized[slot] > quantized[largest]) largest = slot;
+		}
+		int target = (int)floorf(min(total, 1.0f) * one + 0.5f);
+		if (sum > 0)
+			quantized[largest] = (unsigned int)max(0, (int)quantized[largest] + target - sum);
+
+		for (unsigned int slot = 0; slot < slots; slot++) {
+			if (format.weightBits == 16) {
+				uint16_t value = (uint16_t)quantized[slot];
+				dst = write(dst, &value, 2);
+			}
+			else
+				*dst++ = (unsigned char)quantized[slot];
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef VIRTUALFILE_H
+#define VIRTUALFILE_H
+
+#include <assetpack.h>
+#include <mappedfile.h>
+
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Virtual file layer
+// ------------------
+// Every loader (models, textures, cube maps, shaders and the baked caches) reads through here.
+// A path is looked up in the mounted asset packs first, the last mounted one winning, and read
+// from the disk when no pack has it, so a build without a pack keeps working with the loose
+// files and a pack can be dropped next to the executable to replace them. Mount the packs before
+// the loading starts: the lookups take no lock.
+class VirtualFileSystem
+{
+public:
+	struct Stats
+	{
+		unsigned long long packedFiles;
+		unsigned long long looseFiles;
+		unsigned long long packedBytes; // as stored in the pack
+		unsigned long long looseBytes;
+	};
+
+	static VirtualFileSystem& Get() {
+		static VirtualFileSystem instance;
+		return instance;
+	}
+
+	// adds the pack at 'path' to the search, false if it is missing or not valid
+	bool Mount(const string &path) {
+		unique_ptr<AssetPack> pack(new AssetPack());
+		if (!pack->Open(path)) return false;
+		cout << "VirtualFileSystem: mounted " << path << ", " << pack->EntryCount() << " files" << endl;
+		packs.push_back(std::move(pack));
+		return true;
+	}
+
+	bool HasPacks() const { return !packs.empty(); }
+
+	bool Exists(const string &path) const {
+		const AssetPack *pack;
+		if (find(path, pack) != nullptr) return true;
+		long long time;
+		return GetFileModifiedTime(path, time);
+	}
+
+	// whole contents of a file
+	bool ReadFile(const string &path, vector<unsigned char> &bytes) const {
+		const AssetPack *pack;
+		const AssetPackEntry *entry = find(path, pack);
+		if (entry != nullptr) {
+			packedFiles++;
+			packedBytes += entry->storedSize;
+			return pack->Read(*entry, bytes);
+		}
+
+		ifstream file(path.c_str(), ios::binary | ios::ate);
+		if (!file) return false;
+		streamoff size = file.tellg();
+		if (size < 0) return false;
+		bytes.resize((size_t)size);
+		file.seekg(0);
+		if (size > 0) file.read((char*)bytes.data(), size);
+		looseFiles++;
+		looseBytes += (unsigned long long)size;
+		return (bool)file;
+	}
+
+	bool ReadText(const string &path, string &text) const {
+		vector<unsigned char> bytes;
+		if (!ReadFile(path, bytes)) return false;
+		text.assign(bytes.begin(), bytes.end());
+		return true;
+	}
+
+	// bytes read to load the file (its compressed size when it comes from a pack), 0 if missing
+	unsigned long long StoredSize(const string &path) const {
+		const AssetPack *pack;
+		const AssetPackEntry *entry = find(path, pack);
+		if (entry != nullptr) return entry->storedSize;
+		ifstream file(path.c_str(), ios::binary | ios::ate);
+		return file ? (unsigned long long)file.tellg() : 0;
+	}
+
+	// modification time of the file, for a packed one the time its source had when it was packed
+	bool ModifiedTime(const string &path, long long &time) const {
+		const AssetPack *pack;
+		const AssetPackEntry *entry = find(path, pack);
+		if (entry != nullptr) {
+			time = entry->modifiedTime;
+			return true;
+		}
+		return GetFileModifiedTime(path, time);
+	}
+
+	// the entry of a path in the packs, null when it would be read from the disk
+	const AssetPackEntry* Find(const string &path, const AssetPack *&pack) const {
+		return find(path, pack);
+	}
+
+	Stats GetStats() const {
+		Stats stats;
+		stats.packedFiles = packedFiles;
+		stats.looseFiles = looseFiles;
+		stats.packedBytes = packedBytes;
+		stats.looseBytes = looseBytes;
+		return stats;
+	}
+
+	void PrintStats() const {
+		Stats current = GetStats();
+		cout << "VirtualFileSystem: " << current.packedFiles << " files from packs (" << current.packedBytes / 1024 << " KB), "
+			<< current.looseFiles << " loose files (" << current.looseBytes / 1024 << " KB)" << endl;
+	}
+
+private:
+	vector<unique_ptr<AssetPack> >     packs;
+	mutable atomic<unsigned long long> packedFiles;
+	mutable atomic<unsigned long long> looseFiles;
+	mutable atomic<unsigned long long> packedBytes;
+	mutable atomic<unsigned long long> looseBytes;
+
+	VirtualFileSystem() : packedFiles(0), looseFiles(0), packedBytes(0), looseBytes(0) {}
+	VirtualFileSystem(const VirtualFileSystem&);
+	VirtualFileSystem& operator=(const VirtualFileSystem&);
+
+	const AssetPackEntry* find(const string &path, const AssetPack *&pack) const {
+		for (size_t i = packs.size(); i-- > 0;) {
+			const AssetPackEntry *entry = packs[i]->Find(path);
+			if (entry != nullptr) {
+				pack = packs[i].get();
+				return entry;
+			}
+		}
+		pack = nullptr;
+		return nullptr;
+	}
+};
+
+// Read-only view of a whole file through the VirtualFileSystem, for the baked caches: a packed
+// entry stored as it is is used in place from the mapping of the pack, a compressed one is
+// decompressed into memory and a loose file is mapped.
+class VirtualFile
+{
+public:
+	VirtualFile() : data(nullptr), size(0) {}
+
+	bool Open(const string &path) {
+		Close();
+		const AssetPack *pack;
+		const AssetPackEntry *entry = VirtualFileSystem::Get().Find(path, pack);
+		if (entry == nullptr) {
+			if (!mapped.Open(path)) return false;
+			data = mapped.Data();
+			size = mapped.Size();
+			return true;
+		}
+		data = pack->StoredData(*entry);
+		size = (size_t)entry->size;
+		if (data == nullptr) {
+			if (!pack->Read(*entry, buffer)) return false;
+			data = buffer.data();
+		}
+		return size > 0;
+	}
+
+	void Close() {
+		mapped.Close();
+		buffer.clear();
+		buffer.shrink_to_fit();
+		data = nullptr;
+		size = 0;
+	}
+
+	bool IsOpen() const { return data != nullptr; }
+	const unsigned char* Data() const { return data; }
+	size_t Size() const { return size; }
+
+private:
+	MappedFile            mapped;
+	vector<unsigned char> buffer;
+	const unsigned char  *data;
+	size_t                size;
+
+	VirtualFile(const VirtualFile&);
+	VirtualFile& operator=(const VirtualFile&);
+};
+
+#endif
@@ -13,12 +13,18 @@
 
 // Model loading classes
 #include <shader_m.h>
+#include <shaderregistry.h>
 #include <camera.h>
 #include <model.h>
 #include <animatedmodel.h>
 #include <material.h>
 #include <light.h>
 #include <cubemap.h>
+#include <assetmanager.h>
+#include <modelasset.h>
+#include <staticbatch.h>
+#include <uniformblocks.h>
+#include <loadprofiler.h>
 
 // Functions
 bool Start();
@@ -49,11 +55,29 @@ float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 float elapsedTime = 0.0f;
 
-// Shaders
-Shader* mLightsShader;
-Shader* cubemapShader;
-Shader* fresnelShader;
-Shader* dynamicShader;
+// What the meshlet culling did in the last frame, printed at shutdown
+MeshletCullStats lastCullStats;
+
+// Shaders, owned by the ShaderRegistry
+std::shared_ptr<Shader> mLightsShader;
+std::shared_ptr<Shader> cubemapShader;
+std::shared_ptr<Shader> fresnelShader;
+std::shared_ptr<Shader> dynamicShader;
+std::shared_ptr<Shader> basicShader; // light indicators
+
+// view, projection, camera and lights, shared by every program through uniform blocks
+FrameUniforms* frameUniforms;
+
+// Uniforms set every frame, looked up once after linking instead of by name at every set
+struct FresnelUniforms
+{
+    UniformHandle diffuseMap, skybox, refractionRatio, bias, scale, power, alpha;
+} fresnelUniforms;
+
+struct SkinningUniforms
+{
+    UniformHandle model, bones;
+} skinningUniforms;
 
 // Models
 Model* lightDummy;
@@ -62,27 +86,22 @@ Model* material_metalico;
 Model* material_plastico;
 Model* material_translucido;
 AnimatedModel* astronauta;
-Model* satelite;
-Model* estacionDentro;
-Model* nave;
+StaticBatch* staticScenery; // station inside and outside and the satellite, baked into world space
 //Model* controles;
 //Model* silla;
 
 // Cubemap
 CubeMap* mainCubeMap;
 
+// Textures decoded in the background and uploaded a few per frame
+TextureStreamer* textureStreamer;
+
 // Lights
 std::vector<Light> gLights;
 
 // Materials
 Material material01;
 
-// Light uniform setters
-void SetLightUniformInt(Shader* shader, const char* propertyName, size_t lightIndex, int value);
-void SetLightUniformFloat(Shader* shader, const char* propertyName, size_t lightIndex, float value);
-void SetLightUniformVec4(Shader* shader, const char* propertyName, size_t lightIndex, glm::vec4 value);
-void SetLightUniformVec3(Shader* shader, const char* propertyName, size_t lightIndex, glm::vec3 value);
-
 int main()
 {
     if (!Start())
@@ -94,6 +113,13 @@ int main()
             break;
     }
 
+    // what the last frame culled and set, and the programs compiled while drawing
+    lastCullStats.Print();
+    Shader::Stats().Print();
+    Shader::CompileStats().Print();
+
+    delete frameUniforms;
+    ShaderRegistry::Get().Clear();
     glfwTerminate();
     return 0;
 }
@@ -124,28 +150,44 @@ bool Start() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return false;
     }
+    // the baked texture formats the driver takes, before any texture is decoded
+    QueryBlockFormats();
 
     // Enable depth testing
     glEnable(GL_DEPTH_TEST);
 
-    // Load shaders
-    mLightsShader = new Shader("shaders/11_PhongShaderMultLights.vs", "shaders/11_PhongShaderMultLights.fs");
-    cubemapShader = new Shader("shaders/10_vertex_cubemap.vs", "shaders/10_fragment_cubemap.fs");
-    fresnelShader = new Shader("shaders/11_fresnel.vs", "shaders/11_fresnel.fs");
-    dynamicShader = new Shader("shaders/10_vertex_skinning-IT.vs", "shaders/10_fragment_skinning-IT.fs");
-    dynamicShader->setBonesIDs(MAX_RIGGING_BONES);
+    // Assets come from the pack written by the AssetPacker when there is one, the loose files
+    // under models/, textures/ and shaders/ otherwise
+    VirtualFileSystem::Get().Mount("assets.pack");
 
     // Load models
-    lightDummy = new Model("models/IllumModels/lightDummy.fbx");
-    material_translucido = new Model("models/IllumModels/material_translucido.fbx");
-    material_metalico = new Model("models/IllumModels/material_metalico.fbx");
-    material_plastico = new Model("models/IllumModels/material_plastico.fbx");
-    astronauta = new AnimatedModel("models/IllumModels/astronauta.fbx");
-    satelite = new Model("models/IllumModels/satellite.fbx");
-    estacionDentro = new Model("models/IllumModels/EstacionDentro.fbx");
-    //controles = new Model("models/IllumModels/Controles.fbx");
-    //silla = new Model("models/IllumModels/Silla.fbx");
-    nave = new Model("models/IllumModels/ESTACIONESPACIAL.fbx");
+    // Every request is queued at once: Assimp import, mesh processing and image decoding run on the
+    // asset manager workers, while the GL uploads happen here when each result is collected.
+    // Textures are streamed: models show 1x1 placeholders until Update() swaps the images in.
+    AssetManager assets;
+    textureStreamer = new TextureStreamer();
+    ModelLoadOptions streamed;
+    streamed.streamer = textureStreamer;
+    streamed.cpuData = MESH_CPU_RELEASE; // nothing reads the vertices back on the CPU, the static batch copies them on the GPU
+    ModelLoadOptions largeModel = streamed; // station models: many sub-meshes converted in parallel and optimized
+    largeModel.parallelMeshes = true;
+    largeModel.optimizeMeshes = true;
+    largeModel.lodLevels = 4;
+    largeModel.buildMeshlets = true;
+    ModelLoadOptions distantModel = streamed; // seen small most of the time: levels of detail
+    distantModel.lodLevels = 4;
+    ModelLoadOptions skinnedModel = streamed; // the 4 largest bone influences per vertex, a third of the skinning work
+    skinnedModel.maxInfluences = 4;
+    AssetFuture<Model> lightDummyAsset = assets.LoadModel("models/IllumModels/lightDummy.fbx", streamed);
+    AssetFuture<Model> translucidoAsset = assets.LoadModel("models/IllumModels/material_translucido.fbx", streamed);
+    AssetFuture<Model> metalicoAsset = assets.LoadModel("models/IllumModels/material_metalico.fbx", streamed);
+    AssetFuture<Model> plasticoAsset = assets.LoadModel("models/IllumModels/material_plastico.fbx", streamed);
+    AssetFuture<AnimatedModel> astronautaAsset = assets.LoadAnimatedModel("models/IllumModels/astronauta.fbx", 0, skinnedModel);
+    SharedAssetFuture<ModelAsset> sateliteAsset = assets.LoadModelAsset("models/IllumModels/satellite.fbx", distantModel);
+    AssetFuture<Model> estacionDentroAsset = assets.LoadModel("models/IllumModels/EstacionDentro.fbx", largeModel);
+    //AssetFuture<Model> controlesAsset = assets.LoadModel("models/IllumModels/Controles.fbx", streamed);
+    //AssetFuture<Model> sillaAsset = assets.LoadModel("models/IllumModels/Silla.fbx", streamed);
+    AssetFuture<Model> naveAsset = assets.LoadModel("models/IllumModels/ESTACIONESPACIAL.fbx", largeModel);
 
     // Load cubemap
     vector<std::string> faces
@@ -157,8 +199,90 @@ bool Start() {
         "textures/cubemap/01/pz.png",
         "textures/cubemap/01/nz.png"
     };
+    vector<std::future<TextureImage>> faceImages;
+    for (size_t i = 0; i < faces.size(); i++)
+        faceImages.push_back(assets.LoadImage(faces[i]));
+
+    // Load shaders while the workers import the assets
+    frameUniforms = new FrameUniforms();
+    ShaderRegistry &shaders = ShaderRegistry::Get();
+    mLightsShader = shaders.Acquire("shaders/11_PhongShaderMultLights.vs", "shaders/11_PhongShaderMultLights.fs");
+    cubemapShader = shaders.Acquire("shaders/10_vertex_cubemap.vs", "shaders/10_fragment_cubemap.fs");
+    fresnelShader = shaders.Acquire("shaders/11_fresnel.vs", "shaders/11_fresnel.fs");
+    basicShader = shaders.Acquire("shaders/10_vertex_simple.vs", "shaders/10_fragment_simple.fs");
+    fresnelUniforms.diffuseMap = fresnelShader->Uniform("diffuseMap");
+    fresnelUniforms.skybox = fresnelShader->Uniform("skybox");
+    fresnelUniforms.refractionRatio = fresnelShader->Uniform("mRefractionRatio");
+    fresnelUniforms.bias = fresnelShader->Uniform("_Bias");
+    fresnelUniforms.scale = fresnelShader->Uniform("_Scale");
+    fresnelUniforms.power = fresnelShader->Uniform("_Power");
+    fresnelUniforms.alpha = fresnelShader->Uniform("uAlpha");
+
+    // GL uploads, in the context thread
+    lightDummy = lightDummyAsset.Get();
+    material_translucido = translucidoAsset.Get();
+    material_metalico = metalicoAsset.Get();
+    material_plastico = plasticoAsset.Get();
+    astronauta = astronautaAsset.Get();
+    // the skinning variant that reads as many influences as the astronaut kept
+    dynamicShader = shaders.Acquire(SkinningVertexShader(astronauta->Influences()), "shaders/10_fragment_skinning-IT.fs");
+    dynamicShader->setBonesIDs(MAX_RIGGING_BONES);
+    skinningUniforms.model = dynamicShader->Uniform("model");
+    skinningUniforms.bones = dynamicShader->Uniform("gBones");
+    // Nothing in the station moves: the inside, the outside and the satellite next to it are
+    // baked into world space once and merged by material, so they draw with a call per material
+    // and the models can go. The satellite is a placement of a shared asset, more copies of it
+    // would add no import or texture.
+    staticScenery = new StaticBatch();
+    {
+        Model* estacionDentro = estacionDentroAsset.Get();
+        glm::mat4 estacionModel = glm::mat4(1.0f);
+        estacionModel = glm::translate(estacionModel, glm::vec3(10.0f, 0.0f, -30.0f)); // Ajusta si no se ve
+        estacionModel = glm::rotate(estacionModel, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+        estacionModel = glm::scale(estacionModel, glm::vec3(2.2f, 2.2f, 2.2f)); // Escala sugerida segn Blender
+        staticScenery->Add(estacionDentro->meshes, estacionModel);
+        delete estacionDentro;
+    }
+    //controles = controlesAsset.Get();
+    //silla = sillaAsset.Get();
+    {
+        Model* nave = naveAsset.Get();
+        glm::mat4 naveModel = glm::mat4(1.0f);
+        naveModel = glm::translate(naveModel, glm::vec3(10.0f, 0.0f, -15.0f)); // Ajusta si no se ve
+        naveModel = glm::scale(naveModel, glm::vec3(0.05f) * 1.0f); // Escala sugerida segn Blender
+        staticScenery->Add(nave->meshes, naveModel);
+        delete nave;
+    }
+    {
+        shared_ptr<ModelAsset> satelite = sateliteAsset.Get();
+        glm::mat4 sateliteModel = glm::mat4(1.0f);
+        sateliteModel = glm::translate(sateliteModel, glm::vec3(50.0f, 0.0f, -15.0f)); // Ajusta si no se ve
+        sateliteModel = glm::scale(sateliteModel, glm::vec3(0.01f)); // Escala sugerida segn Blender
+        staticScenery->Add(satelite->Meshes(), sateliteModel);
+    }
+    staticScenery->Build("static scenery");
+
+    // geometry that stays loaded, in RAM and in VRAM
+    GeometryMemory sceneMemory;
+    Model* loadedModels[] = { lightDummy, material_translucido, material_metalico, material_plastico };
+    for (unsigned int i = 0; i < sizeof(loadedModels) / sizeof(loadedModels[0]); i++) {
+        loadedModels[i]->Memory().Print(loadedModels[i]->filename);
+        sceneMemory.Add(loadedModels[i]->Memory());
+    }
+    astronauta->Memory().Print(astronauta->filename);
+    sceneMemory.Add(astronauta->Memory());
+    staticScenery->Memory().Print("static scenery");
+    sceneMemory.Add(staticScenery->Memory());
+    sceneMemory.Print("scene");
+
+    vector<TextureImage> faceData;
+    for (size_t i = 0; i < faceImages.size(); i++)
+        faceData.push_back(faceImages[i].get());
     mainCubeMap = new CubeMap();
-    mainCubeMap->loadCubemap(faces);
+    mainCubeMap->loadCubemap(faceData);
+    TextureCache::Get().PrintStats();
+    VirtualFileSystem::Get().PrintStats();
+    ShaderRegistry::Get().PrintStats();
 
     // Configure lights
     Light light01; //Luz de la escena
@@ -192,6 +316,10 @@ bool Start() {
     material01.diffuse = glm::vec4(0.85f, 0.85f, 0.85f, 1.0f); // Buena reflexin difusa
     material01.specular = glm::vec4(0.3f, 0.3f, 0.3f, 1.0f);    // Mate = poca especularidad
     material01.transparency = 1.0f;
+
+    // where the loading time went, per asset and per stage (textures still streaming are not in it)
+    LoadProfiler::Get().Print();
+    LoadProfiler::Get().WriteJSON("load_profile.json");
     return true;
 }
 
@@ -203,6 +331,9 @@ bool Update() {
 
     elapsedTime += deltaTime;
 
+    // Swap in the textures that finished decoding, within a fixed per-frame budget
+    textureStreamer->Update();
+
     // Parpadeo de luz de alarma (por ejemplo cada 0.5 segundos)
     float blinkingInterval = 0.5f; // 0.5 segundos
     float timeMod = fmod(currentFrame, blinkingInterval * 2.0f); // Ciclo de 1s
@@ -233,10 +364,18 @@ bool Update() {
     glm::mat4 view;
     projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 10000.0f);
     view = camera.GetViewMatrix();
+    LodView lodView(camera.Position, glm::radians(camera.Zoom), (float)SCR_HEIGHT);
+    // frustum culling only: nothing enables GL_CULL_FACE, the back faces of the station are
+    // drawn and seen from inside, so the cone test would take away visible clusters
+    CullView cullView(projection * view, camera.Position, false);
+
+    // Camera and lights for every shader: one buffer update each
+    frameUniforms->SetFrame(view, projection, camera.Position, currentFrame);
+    frameUniforms->SetLights(gLights);
 
     // Draw cubemap background
     {
-        mainCubeMap->drawCubeMap(*cubemapShader, projection, view);
+        mainCubeMap->drawCubeMap(*cubemapShader);
     }
 
 
@@ -246,28 +385,11 @@ bool Update() {
         glEnable(GL_BLEND);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-        mLightsShader->setMat4("projection", projection);
-        mLightsShader->setMat4("view", view);
-
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
         model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
         model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
         mLightsShader->setMat4("model", model);
-        // Configure lights
-        mLightsShader->setInt("numLights", (int)gLights.size());
-        for (size_t i = 0; i < gLights.size(); ++i) {
-            // No transformar la posicin de la luz aqu, mantenindola en el espacio global
-            SetLightUniformVec3(mLightsShader, "Position", i, gLights[i].Position);
-            SetLightUniformVec3(mLightsShader, "Direction", i, gLights[i].Direction);
-            SetLightUniformVec4(mLightsShader, "Color", i, gLights[i].Color);
-            SetLightUniformVec4(mLightsShader, "Power", i, gLights[i].Power);
-            SetLightUniformInt(mLightsShader, "alphaIndex", i, gLights[i].alphaIndex);
-            SetLightUniformFloat(mLightsShader, "distance", i, gLights[i].distance);
-        }
-
-        mLightsShader->setVec3("eye", camera.Position);
-
         // Set material properties
         mLightsShader->setVec4("MaterialAmbientColor", material01.ambient);
         mLightsShader->setVec4("MaterialDiffuseColor", material01.diffuse);
@@ -283,9 +405,6 @@ bool Update() {
         glEnable(GL_BLEND);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-        fresnelShader->setMat4("projection", projection);
-        fresnelShader->setMat4("view", view);
-
         // Enlazar texturas para Fresnel
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, material_metalico->getFirstDiffuseTextureID());
@@ -293,22 +412,17 @@ bool Update() {
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_CUBE_MAP, mainCubeMap->getID());
 
-        fresnelShader->setInt("diffuseMap", 0);
-        fresnelShader->setInt("skybox", 1);
+        fresnelShader->setInt(fresnelUniforms.diffuseMap, 0);
+        fresnelShader->setInt(fresnelUniforms.skybox, 1);
 
-        // Draw parte interna de la nave
-        glm::mat4 estacionModel = glm::mat4(1.0f);
-        estacionModel = glm::translate(estacionModel, glm::vec3(10.0f, 0.0f, -30.0f)); // Ajusta si no se ve
-        estacionModel = glm::rotate(estacionModel, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        estacionModel = glm::scale(estacionModel, glm::vec3(2.2f, 2.2f, 2.2f)); // Escala sugerida segn Blender
-        fresnelShader->setMat4("model", estacionModel);
-        fresnelShader->setVec3("cameraPosition", camera.Position);
-        fresnelShader->setFloat("mRefractionRatio", 1.0f / 1.003f); // Aire
-        fresnelShader->setFloat("_Bias", -0.2f);
-        fresnelShader->setFloat("_Scale", 0.15f);
-        fresnelShader->setFloat("_Power", 1.0f);
-        fresnelShader->setFloat("uAlpha", 1.0f); // Opaco
-        estacionDentro->Draw(*fresnelShader);
+        // Draw parte interna y externa de la nave, y el satelite: static scenery, already in world space.
+        // The constants are only sent the first frame, the shader skips values it already has.
+        fresnelShader->setFloat(fresnelUniforms.refractionRatio, 1.0f / 1.003f); // Aire
+        fresnelShader->setFloat(fresnelUniforms.bias, -0.2f);
+        fresnelShader->setFloat(fresnelUniforms.scale, 0.15f);
+        fresnelShader->setFloat(fresnelUniforms.power, 1.0f);
+        fresnelShader->setFloat(fresnelUniforms.alpha, 1.0f); // Opaco
+        staticScenery->Draw(*fresnelShader, lodView, &cullView);
 
         /*
         // Controles de la nave
@@ -343,47 +457,19 @@ bool Update() {
         silla->Draw(*fresnelShader);
         */
 
-        // Draw parte externa de la nave
-        glm::mat4 naveModel = glm::mat4(1.0f);
-        naveModel = glm::translate(naveModel, glm::vec3(10.0f, 0.0f, -15.0f)); // Ajusta si no se ve
-        naveModel = glm::scale(naveModel, glm::vec3(0.05f) * 1.0f); // Escala sugerida segn Blender
-        fresnelShader->setMat4("model", naveModel);
-        fresnelShader->setVec3("cameraPosition", camera.Position);
-        fresnelShader->setFloat("mRefractionRatio", 1.0f / 1.003f); // Aire
-        fresnelShader->setFloat("_Bias", -0.2f);
-        fresnelShader->setFloat("_Scale", 0.15f);
-        fresnelShader->setFloat("_Power", 1.0f);
-        fresnelShader->setFloat("uAlpha", 1.0f); // Opaco
-        nave->Draw(*fresnelShader);
-
-
-        // Draw animated character
-        glm::mat4 sateliteModel = glm::mat4(1.0f);
-        sateliteModel = glm::translate(sateliteModel, glm::vec3(50.0f, 0.0f, -15.0f)); // Ajusta si no se ve
-        sateliteModel = glm::scale(sateliteModel, glm::vec3(0.01f)); // Escala sugerida segn Blender
-        fresnelShader->setMat4("model", sateliteModel);
-        fresnelShader->setVec3("cameraPosition", camera.Position);
-        fresnelShader->setFloat("mRefractionRatio", 1.0f / 1.003f); // Aire
-        fresnelShader->setFloat("_Bias", -0.2f);
-        fresnelShader->setFloat("_Scale", 0.15f);
-        fresnelShader->setFloat("_Power", 1.0f);
-        fresnelShader->setFloat("uAlpha", 1.0f); // Opaco
-        satelite->Draw(*fresnelShader);
 
 
         // Draw animated character
         {
             astronauta->UpdateAnimation(deltaTime);
             dynamicShader->use();
-            dynamicShader->setMat4("projection", projection);
-            dynamicShader->setMat4("view", view);
 
             glm::mat4 model = glm::mat4(1.0f);
             model = glm::translate(model, glm::vec3(3.0f, 0.0f, -3.0f));
             model = glm::rotate(model, glm::radians(45.0f), glm::vec3(0.0f, 0.0f, 1.0f));
             model = glm::scale(model, glm::vec3(0.01f, 0.01f, 0.01f));
-            dynamicShader->setMat4("model", model);
-            dynamicShader->setMat4("gBones", MAX_RIGGING_BONES, astronauta->gBones);
+            dynamicShader->setMat4(skinningUniforms.model, model);
+            dynamicShader->setMat4(skinningUniforms.bones, MAX_RIGGING_BONES, astronauta->gBones);
             astronauta->Draw(*dynamicShader);
         }
 
@@ -392,10 +478,7 @@ bool Update() {
 
     // Draw light indicators
     {
-        Shader basicShader("shaders/10_vertex_simple.vs", "shaders/10_fragment_simple.fs");
-        basicShader.use();
-        basicShader.setMat4("projection", projection);
-        basicShader.setMat4("view", view);
+        basicShader->use();
 
         glm::mat4 model;
         for (size_t i = 0; i < gLights.size(); ++i) {
@@ -403,13 +486,19 @@ bool Update() {
             model = glm::translate(model, gLights[i].Position);
             model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
             model = glm::scale(model, glm::vec3(0.1f, 0.1f, 0.1f));
-            basicShader.setMat4("model", model);
-            lightDummy->Draw(basicShader);
+            basicShader->setMat4("model", model);
+            lightDummy->Draw(*basicShader);
         }
     }
 
     glUseProgram(0);
 
+    // what the meshlet culling and the uniform shadowing skipped this frame, and the programs
+    // compiled while drawing (a hitch each), kept for the report at shutdown
+    Shader::Stats().EndFrame();
+    Shader::CompileStats().EndFrame();
+    lastCullStats = cullView.stats;
+
     // Swap buffers
     glfwSwapBuffers(window);
     glfwPollEvents();
@@ -467,32 +556,3 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
     camera.ProcessMouseScroll((float)yoffset);
 }
-
-// Light uniform setters implementation
-void SetLightUniformInt(Shader* shader, const char* propertyName, size_t lightIndex, int value) {
-    std::ostringstream ss;
-    ss << "allLights[" << lightIndex << "]." << propertyName;
-    std::string uniformName = ss.str();
-    shader->setInt(uniformName.c_str(), value);
-}
-
-void SetLightUniformFloat(Shader* shader, const char* propertyName, size_t lightIndex, float value) {
-    std::ostringstream ss;
-    ss << "allLights[" << lightIndex << "]." << propertyName;
-    std::string uniformName = ss.str();
-    shader->setFloat(uniformName.c_str(), value);
-}
-
-void SetLightUniformVec4(Shader* shader, const char* propertyName, size_t lightIndex, glm::vec4 value) {
-    std::ostringstream ss;
-    ss << "allLights[" << lightIndex << "]." << propertyName;
-    std::string uniformName = ss.str();
-    shader->setVec4(uniformName.c_str(), value);
-}
-
-void SetLightUniformVec3(Shader* shader, const char* propertyName, size_t lightIndex, glm::vec3 value) {
-    std::ostringstream ss;
-    ss << "allLights[" << lightIndex << "]." << propertyName;
-    std::string uniformName = ss.str();
-    shader->setVec3(uniformName.c_str(), value);
-}
\ No newline at end of file
@@ -0,0 +1,141 @@
+// TextureBaker: compresses the images of the project into .ctex containers (BC1/BC3/BC5/BC7 with
+// the whole mip chain) that TextureFromFile, the texture streamer and CubeMap::loadCubemap pick
+// up instead of the source image.
+//
+// Usage (from bin/): TextureBaker [-bc7] [-bc5normals] [-force] [files or folders...]
+//   -bc7         BC7 for every image instead of BC1 (opaque) / BC3 (with alpha)
+//   -bc5normals  BC5 for images named like normal maps; the shader then has to rebuild Z
+//   -force       bake even if the container is up to date
+// Without paths it bakes models/ and textures/.
+
+#include <bcencoder.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace fs = std::filesystem;
+
+struct BakeSettings
+{
+	bool allBC7;
+	bool normalsBC5;
+	bool force;
+
+	BakeSettings() : allBC7(false), normalsBC5(false), force(false) {}
+};
+
+static bool IsImageFile(const fs::path &path)
+{
+	string extension = path.extension().string();
+	transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+	return extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" || extension == ".bmp";
+}
+
+static bool IsNormalMap(const fs::path &path)
+{
+	string name = path.stem().string();
+	transform(name.begin(), name.end(), name.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+	bool suffix = name.size() > 2 && name.compare(name.size() - 2, 2, "_n") == 0;
+	return suffix || name.find("normal") != string::npos || name.find("_nrm") != string::npos;
+}
+
+static unsigned int ChooseFormat(const fs::path &path, const unsigned char *rgba, int width, int height, const BakeSettings &settings)
+{
+	if (settings.normalsBC5 && IsNormalMap(path))
+		return BLOCK_BC5;
+	if (settings.allBC7)
+		return BLOCK_BC7;
+	for (size_t i = 0; i < (size_t)width * height; i++)
+		if (rgba[i * 4 + 3] != 255)
+			return BLOCK_BC3;
+	return BLOCK_BC1;
+}
+
+static bool BakeImage(const fs::path &path, const BakeSettings &settings, size_t &sourceBytes, size_t &bakedBytes)
+{
+	string filename = path.generic_string();
+	if (!settings.force) {
+		CompressedTexture existing;
+		if (existing.Load(filename)) {
+			cout << filename << ": up to date" << endl;
+			return true;
+		}
+	}
+
+	int width, height, components;
+	unsigned char *rgba = stbi_load(filename.c_str(), &width, &height, &components, 4);
+	if (!rgba) {
+		cout << "ERROR::TEXTUREBAKER:: could not read " << filename << endl;
+		return false;
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	CompressedTexture texture;
+	CompressTexture(rgba, (unsigned int)width, (unsigned int)height, ChooseFormat(path, rgba, width, height, settings), texture);
+	double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	stbi_image_free(rgba);
+
+	if (!texture.Write(filename)) {
+		cout << "ERROR::TEXTUREBAKER:: could not write " << CompressedTexture::ContainerPath(filename) << endl;
+		return false;
+	}
+
+	// what the runtime used to upload: RGBA8 (or RGB8) plus a third for the generated mips
+	size_t uncompressed = (size_t)width * height * (components == 4 ? 4 : 3) * 4 / 3;
+	sourceBytes += uncompressed;
+	bakedBytes += texture.Size();
+	cout << filename << ": " << width << "x" << height << " " << BlockFormatName(texture.format) << ", "
+		<< texture.levels.size() << " levels, " << texture.Size() / 1024 << " KB (was " << uncompressed / 1024 << " KB), "
+		<< ms << " ms" << endl;
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	BakeSettings settings;
+	vector<fs::path> inputs;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "-bc7") settings.allBC7 = true;
+		else if (arg == "-bc5normals") settings.normalsBC5 = true;
+		else if (arg == "-force") settings.force = true;
+		else inputs.push_back(fs::path(arg));
+	}
+	if (inputs.empty()) {
+		inputs.push_back("models");
+		inputs.push_back("textures");
+	}
+
+	vector<fs::path> images;
+	for (size_t i = 0; i < inputs.size(); i++) {
+		error_code error;
+		if (fs::is_directory(inputs[i], error)) {
+			for (fs::recursive_directory_iterator it(inputs[i], error), end; it != end; it.increment(error))
+				if (it->is_regular_file() && IsImageFile(it->path()))
+					images.push_back(it->path());
+		}
+		else if (fs::is_regular_file(inputs[i], error))
+			images.push_back(inputs[i]);
+		else
+			cout << "WARNING::TEXTUREBAKER:: skipping " << inputs[i].generic_string() << endl;
+	}
+
+	// the encoder already spreads every image over all the cores
+	size_t sourceBytes = 0, bakedBytes = 0;
+	unsigned int failed = 0;
+	for (size_t i = 0; i < images.size(); i++)
+		if (!BakeImage(images[i], settings, sourceBytes, bakedBytes))
+			failed++;
+
+	cout << images.size() - failed << " of " << images.size() << " images baked";
+	if (bakedBytes > 0)
+		cout << ", " << sourceBytes / 1024 << " KB -> " << bakedBytes / 1024 << " KB (" << (float)sourceBytes / bakedBytes << "x)";
+	cout << endl;
+	return failed == 0 ? 0 : 1;
+}